@@ -6,15 +6,21 @@
 #include <vector>
 #include <cstdint>
 #include <optional>
+#include <functional>
 
 #include "Utils.h"
 
 #pragma comment(lib, "Winhttp.lib")
 
-std::vector<uint8_t> HttpClient(const char *verb, const std::wstring &url, bool *res = nullptr)
+using HttpDataCallback = std::function<bool(const uint8_t *data, size_t size)>;
+
+// Hands every piece of the body to onData as soon as it arrives, for long lived responses.
+// Stops when the server ends the response or onData returns false.
+bool HttpStream(const char *verb, const std::wstring &url, const HttpDataCallback &onData)
 {
     HINTERNET hSession = NULL, hConnect = NULL, hRequest = NULL;
     std::vector<uint8_t> buffer;
+    bool ok = false;
 
     try {
         std::wstring hostname;
@@ -80,25 +86,7 @@ std::vector<uint8_t> HttpClient(const char *verb, const std::wstring &url, bool
         }
 
         DWORD size = 0;
-        WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_CONTENT_LENGTH,
-                            WINHTTP_HEADER_NAME_BY_INDEX, NULL,
-                            &size, WINHTTP_NO_HEADER_INDEX);
-
-        if (GetLastError() == ERROR_INSUFFICIENT_BUFFER && size > 0) {
-            std::wstring headers;
-            headers.resize(size);
-
-            // Now, use WinHttpQueryHeaders to retrieve the header.
-            if (WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_CONTENT_LENGTH,
-                                    WINHTTP_HEADER_NAME_BY_INDEX,
-                                    headers.data(), &size,
-                                    WINHTTP_NO_HEADER_INDEX)) {
-                buffer.resize(_wtoi(headers.c_str()));
-            }
-        }
-
-        size_t ptr = 0;
-        DWORD  downloaded = 0;
+        DWORD downloaded = 0;
         do {
             size = 0;
             if (!WinHttpQueryDataAvailable(hRequest, &size)) {
@@ -109,26 +97,23 @@ std::vector<uint8_t> HttpClient(const char *verb, const std::wstring &url, bool
                 break;
             }
 
-            if (buffer.size() < ptr + size) {
-                buffer.resize(ptr + size);
+            if (buffer.size() < size) {
+                buffer.resize(size);
             }
 
-            if (!WinHttpReadData(hRequest, buffer.data() + ptr, size, &downloaded)) {
+            if (!WinHttpReadData(hRequest, buffer.data(), size, &downloaded)) {
                 throw std::runtime_error("WinHttpReadData failed");
             }
 
-            ptr += downloaded;
+            if (!onData(buffer.data(), downloaded)) {
+                break;
+            }
         } while (size > 0);
 
-        if (res) {
-            *res = true;
-        }
+        ok = true;
 
     } catch (const std::exception &ex) {
         OutputDebugStringA(ex.what());
-        if (res) {
-            *res = false;
-        }
     }
 
     // Close any open handles.
@@ -139,5 +124,21 @@ std::vector<uint8_t> HttpClient(const char *verb, const std::wstring &url, bool
     if (hSession)
         WinHttpCloseHandle(hSession);
 
+    return ok;
+}
+
+std::vector<uint8_t> HttpClient(const char *verb, const std::wstring &url, bool *res = nullptr)
+{
+    std::vector<uint8_t> buffer;
+
+    auto ok = HttpStream(verb, url, [&](const uint8_t *data, size_t size) {
+        buffer.insert(buffer.end(), data, data + size);
+        return true;
+    });
+
+    if (res) {
+        *res = ok;
+    }
+
     return buffer;
 }
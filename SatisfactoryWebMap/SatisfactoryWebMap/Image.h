@@ -3,9 +3,14 @@
 #include <stb_image.h>
 #include <stb_image_resize.h>
 
+#include <cassert>
 #include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
 #include <string>
 #include <stdexcept>
+#include <vector>
 
 namespace {
 inline void bitblt(void *dstp, size_t dst_stride, const void *srcp, size_t src_stride, size_t row_size, size_t height)
@@ -43,20 +48,13 @@ public:
 
     static Image open(const std::string &fp)
     {
-        FILE *f = fopen(fp.c_str(), "rb");
-        if (f == nullptr) {
+        std::ifstream f(fp, std::ios::binary);
+        if (!f) {
             return Image();
         }
 
-        fseek(f, 0, SEEK_END);
-        auto len = ftell(f);
-        fseek(f, 0, SEEK_SET);
-
-        std::vector<uint8_t> buf(len);
-        fread(&buf[0], 1, len, f);
-        fclose(f);
-
-        return Image::from_bytes(&buf[0], len);
+        std::vector<uint8_t> buf((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+        return Image::from_bytes(buf.data(), buf.size());
     }
 
     static Image from_bytes(const uint8_t *image_data, size_t len)
@@ -138,7 +136,8 @@ public:
         return Image(clone, width, height, ch, order);
     }
 
-    Image(Image &&other) noexcept
+    Image(Image &&other) noexcept :
+        Image()
     {
         if (other.data == nullptr) {
             return;
@@ -157,10 +156,14 @@ public:
 
     Image &operator=(Image &&other) noexcept
     {
-        if (other.data == nullptr) {
+        if (other.data == nullptr || other.data == data) {
             return *this;
         }
 
+        if (data != nullptr) {
+            STBI_FREE(data);
+        }
+
         order = other.order;
 
         data = other.data;
@@ -184,7 +187,11 @@ public:
     }
 
     ~Image()
-    {}
+    {
+        if (data != nullptr) {
+            STBI_FREE(data);
+        }
+    }
 
     bool opened() const
     {
@@ -236,7 +243,7 @@ public:
         }
 
         bitblt(resized, w * ch,
-               data + (width * top + left) * ch, height * ch,
+               data + (width * top + left) * ch, width * ch,
                w * ch, h);
 
         return Image(resized, w, h, ch, order);
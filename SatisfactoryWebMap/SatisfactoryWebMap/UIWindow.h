@@ -46,8 +46,10 @@ static inline ImVec2 operator / (const ImVec2 &a, const ImVec2 &b)
 #include "HttpClient.h"
 #include "Image.h"
 #include "Utils.h"
+#include "base64.h"
 
 #include "../SatisfactoryWebMapServer/Config.h"
+#include "../SatisfactoryWebMapServer/ActorsBinary.h"
 
 struct ID3D11ShaderResourceView;
 
@@ -77,7 +79,7 @@ struct UIWindow
 
     bool useCN = false;
     Config config;
-    std::wstring updateUrl;
+    std::wstring streamUrl;
     std::wstring stopUrl;
 
     const ImVec4 lable_color = ImVec4(1.f, 0.84f, 0.f, 1.f);
@@ -104,7 +106,7 @@ struct UIWindow
     struct ActorResp
     {
         uint8_t type;
-        std::vector<float> pos;
+        float pos[3];
         
         std::string display;
         ImVec2 local_pos;
@@ -155,10 +157,9 @@ struct UIWindow
         }
     }
     
-    void UpdateMap()
+    // Tracks the server ready event, returns true while the server is serving
+    bool CheckServer()
     {
-        using json = nlohmann::json;
-
         HANDLE readyEvent = OpenEventA(EVENT_MODIFY_STATE, false, "SatisfactoryWebMapServerReadyEvent");
         if (readyEvent == NULL) {
             std::unique_lock _(m);
@@ -169,7 +170,7 @@ struct UIWindow
                 serverStarted = false;
             }
 
-            return;
+            return false;
         }
 
         bool isReady = WaitForSingleObject(readyEvent, 0) != WAIT_OBJECT_0;
@@ -178,7 +179,7 @@ struct UIWindow
         if (!isReady) {
             std::unique_lock _(m);
             status = "wait for server ready";
-            return;
+            return false;
         }
 
         if (!serverStarted) {
@@ -186,52 +187,32 @@ struct UIWindow
             status = "server is running";
         }
 
-        auto data = HttpClient("GET", updateUrl);
-        if (data.empty()) {
-            return;
-        }
+        return true;
+    }
 
+    // data is one /api/actors.bin body
+    void UpdateActors(const std::string &data)
+    {
         lastMapUpdate = time.sec();
-        auto actors = json::parse(data);
-        {
-            if (actors.find("status") == actors.end()) {
-                std::unique_lock _(m);
-                status = "invalid data";
-                return;
-            }
 
-            auto status = actors["status"].get<std::string>();
-            if (status == "err") {
-                std::unique_lock _(m);
-                status = "error: " + actors["msg"].get<std::string>();
-                return;
-            }
-
-            auto type = actors["type"].get<std::string>();
-            if (type != "FeatureCollection") {
-                std::unique_lock _(m);
-                status = "invalid data: unkown type";
-                return;
-            }
+        ActorsBinary actors;
+        if (!DecodeActorsBinary(data.data(), data.size(), actors)) {
+            std::unique_lock _(m);
+            status = "invalid data";
+            return;
+        }
 
-            if (!actors["features"].is_array()) {
-                std::unique_lock _(m);
-                status = "invalid data";
-                return;
-            }
+        if (!actors.Valid) {
+            std::unique_lock _(m);
+            status = "error: " + actors.Error;
+            return;
         }
 
         std::vector<ActorResp> items;
-        for (const auto &feature : actors["features"]) {
-            auto type = feature["type"].get<std::string>();
-            if (type != "Feature") {
-                continue;
-            }
-
-            items.push_back({
-                feature["properties"]["type"].get<uint8_t>(),
-                feature["geometry"]["coordinates"].get<std::vector<float>>(),
-            });
+        items.reserve(actors.Count);
+        for (size_t i = 0; i < actors.Count; ++i) {
+            const float *pos = &actors.Position[i * 3];
+            items.push_back({ actors.Type[i], { pos[0], pos[1], pos[2] } });
         }
 
         {
@@ -240,6 +221,57 @@ struct UIWindow
         }
     }
 
+    // Follows /api/actors/stream until the server goes away or the UI stops.
+    // Every event is a full snapshot in the binary format (?format=bin), base64 encoded.
+    void UpdateMap()
+    {
+        if (!CheckServer()) {
+            return;
+        }
+
+        std::string pending;
+        std::string event;
+
+        auto field = [](const std::string &line, size_t from) {
+            auto pos = line.find_first_not_of(' ', from);
+            return pos == std::string::npos ? std::string() : line.substr(pos);
+        };
+
+        HttpStream("GET", streamUrl, [&](const uint8_t *data, size_t size) {
+            pending.append((const char *)data, size);
+
+            size_t end;
+            while ((end = pending.find("\n\n")) != std::string::npos) {
+                std::string eventData;
+
+                size_t pos = 0;
+                while (pos < end) {
+                    auto eol = pending.find('\n', pos);
+                    if (eol == std::string::npos || eol > end) {
+                        eol = end;
+                    }
+
+                    auto line = pending.substr(pos, eol - pos);
+                    if (line.compare(0, 6, "event:") == 0) {
+                        event = field(line, 6);
+                    } else if (line.compare(0, 5, "data:") == 0) {
+                        eventData += field(line, 5);
+                    }
+
+                    pos = eol + 1;
+                }
+                pending.erase(0, end + 2);
+
+                if (!eventData.empty() && event == "snapshot") {
+                    UpdateActors(base64_decode(eventData));
+                }
+                event.clear();
+            }
+
+            return !stop;
+        });
+    }
+
     void SetupUI()
     {
         wchar_t localeName[32];
@@ -277,15 +309,16 @@ struct UIWindow
             config.IP = "127.0.0.1";
         }
 
-        updateUrl = std::atow("http://" + config.IP + ":" + std::to_string(config.Port) + "/api/actors");
+        streamUrl = std::atow("http://" + config.IP + ":" + std::to_string(config.Port) + "/api/actors/stream?format=bin");
         stopUrl = std::atow("http://" + config.IP + ":" + std::to_string(config.Port) + "/api/stop");
 
         stop = false;
 
         updateWorker = std::thread([&] { 
             while (!stop) {
+                // returns when the stream ends, wait a bit before reconnecting
                 UpdateMap();
-                Sleep(3000);
+                Sleep(1000);
             }
         });
     }
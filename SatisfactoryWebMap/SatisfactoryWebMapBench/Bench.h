@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal benchmark harness. Allocations are counted by the operator new replacement
+// in main.cpp, so they include everything the measured code allocates.
+
+struct AllocStats
+{
+	static inline std::atomic<uint64_t> Count = 0;
+	static inline std::atomic<uint64_t> Bytes = 0;
+};
+
+// what a benchmark was run with, like { "actors", 1000 }
+using BenchParams = std::vector<std::pair<std::string, int64_t>>;
+
+struct BenchResult
+{
+	std::string Name;
+	BenchParams Params;
+	uint64_t Iterations;
+	double NsPerOp;
+	double AllocsPerOp;
+	double BytesPerOp;
+};
+
+// Calls fn until minTime has passed, at least once after a warm up call
+template <typename Fn>
+BenchResult RunBench(const std::string &name, const BenchParams &params, Fn &&fn, std::chrono::milliseconds minTime = std::chrono::milliseconds(500))
+{
+	using clock = std::chrono::steady_clock;
+
+	fn();
+
+	uint64_t iterations = 0;
+	uint64_t allocs = AllocStats::Count, bytes = AllocStats::Bytes;
+
+	auto start = clock::now();
+	auto elapsed = clock::duration::zero();
+	uint64_t batch = 1;
+
+	while (elapsed < minTime) {
+		for (uint64_t i = 0; i < batch; ++i) {
+			fn();
+		}
+		iterations += batch;
+		elapsed = clock::now() - start;
+
+		if (batch < (1 << 20)) {
+			batch *= 2;
+		}
+	}
+
+	double n = (double)iterations;
+	return {
+		name,
+		params,
+		iterations,
+		std::chrono::duration<double, std::nano>(elapsed).count() / n,
+		(AllocStats::Count - allocs) / n,
+		(AllocStats::Bytes - bytes) / n,
+	};
+}
+
+template <typename Fn>
+BenchResult RunBench(const std::string &name, Fn &&fn, std::chrono::milliseconds minTime = std::chrono::milliseconds(500))
+{
+	return RunBench(name, {}, std::forward<Fn>(fn), minTime);
+}
+
+// "name/actors=1000"
+inline std::string BenchLabel(const BenchResult &r)
+{
+	auto label = r.Name;
+	for (const auto &param : r.Params) {
+		label += "/" + param.first + "=" + std::to_string(param.second);
+	}
+	return label;
+}
+
+inline void PrintResults(const std::vector<BenchResult> &results)
+{
+	std::printf("%-56s %12s %14s %12s %14s\n", "benchmark", "iterations", "ns/op", "allocs/op", "bytes/op");
+	for (const auto &r : results) {
+		std::printf("%-56s %12llu %14.1f %12.2f %14.1f\n", BenchLabel(r).c_str(), (unsigned long long)r.Iterations,
+			r.NsPerOp, r.AllocsPerOp, r.BytesPerOp);
+	}
+}
+
+// One JSON object per run, for comparing releases. Names and parameter keys are plain identifiers.
+inline bool WriteResultsJson(const std::string &path, const std::vector<BenchResult> &results)
+{
+	std::ofstream out(path);
+	out << std::fixed << "{\n  \"benchmarks\": [";
+
+	for (size_t i = 0; i < results.size(); ++i) {
+		const auto &r = results[i];
+
+		out << (i ? "," : "") << "\n    { \"name\": \"" << r.Name << "\", \"params\": {";
+		for (size_t k = 0; k < r.Params.size(); ++k) {
+			out << (k ? "," : "") << " \"" << r.Params[k].first << "\": " << r.Params[k].second;
+		}
+		out << " }, \"iterations\": " << r.Iterations
+			<< std::setprecision(1) << ", \"ns_per_op\": " << r.NsPerOp
+			<< std::setprecision(3) << ", \"allocs_per_op\": " << r.AllocsPerOp
+			<< std::setprecision(1) << ", \"bytes_per_op\": " << r.BytesPerOp << " }";
+	}
+	out << "\n  ]\n}\n";
+
+	out.close();
+	return !out.fail();
+}
@@ -0,0 +1,422 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "FactoryGameSDK.h"
+
+// A made up game world in process memory, for benchmarks and soak tests without the game.
+//
+// Builds a name table, GUObjectArray, map manager, representation manager and the actor
+// representations with their actors and root components, using the layouts of FactoryGameSDK.h.
+// Install() points Names_0 and GUObjectArray at it, after that the server code reads it through
+// ProcessMemory exactly like the real thing. Step() moves the actors, Churn() makes the garbage
+// collector reuse object slots.
+class FakeGame
+{
+public:
+	enum class Dynamics
+	{
+		Static,     // nothing moves
+		Linear,     // straight lines at constant speed, bouncing off the map edges
+		Circular,   // circles around fixed centers, like trains on a loop
+		RandomWalk, // velocity changes a little every step
+	};
+
+	struct Options
+	{
+		int32_t Actors = 1000;           // representations on the map
+		float MovingShare = 0.25f;       // part of them backed by a real actor with a root component
+		int32_t FillerObjects = 100000;  // other objects in GUObjectArray
+		int32_t FillerNames = 20000;     // other names in the name table
+		std::string MapManagerName = "MapManager";
+		Dynamics Motion = Dynamics::Linear;
+		float Speed = 1500.f;            // cm/s, about a truck
+		uint32_t Seed = 42;
+	};
+
+	// half the size of the map in cm
+	static constexpr float Extent = 375e3f;
+
+	explicit FakeGame(const Options &options) : options(options), rng(options.Seed)
+	{
+		Build();
+	}
+
+	FakeGame(const FakeGame &) = delete;
+	FakeGame &operator=(const FakeGame &) = delete;
+
+	~FakeGame()
+	{
+		if (Names_0 == &names) {
+			Names_0 = nullptr;
+		}
+		if (GUObjectArray == &objects) {
+			GUObjectArray = nullptr;
+		}
+	}
+
+	// Points the game globals at this world
+	void Install() const
+	{
+		Names_0 = &names;
+		GUObjectArray = &objects;
+	}
+
+	const FGMapManager *MapManager() const
+	{
+		return &mapManager;
+	}
+
+	int32_t ObjectCount() const
+	{
+		return objects.ObjObjects.NumElements;
+	}
+
+	int32_t NameCount() const
+	{
+		return names.NumElements;
+	}
+
+	// Moves every real actor by seconds of its dynamics. Not synchronized with readers, torn reads
+	// are what the server sees in the game too.
+	void Step(float seconds)
+	{
+		if (options.Motion == Dynamics::Static) {
+			return;
+		}
+
+		std::normal_distribution<float> kick(0.f, options.Speed);
+
+		for (size_t i = 0; i < motions.size(); ++i) {
+			auto &motion = motions[i];
+			auto &root = roots[i];
+			auto &loc = root.ComponentToWorld.Translation;
+			auto &vel = root.ComponentVelocity;
+
+			if (options.Motion == Dynamics::Circular) {
+				motion.Phase += motion.AngularSpeed * seconds;
+				float c = std::cos(motion.Phase), s = std::sin(motion.Phase);
+
+				loc.x = motion.CenterX + motion.Radius * c;
+				loc.y = motion.CenterY + motion.Radius * s;
+				vel.x = -motion.Radius * motion.AngularSpeed * s;
+				vel.y = motion.Radius * motion.AngularSpeed * c;
+			} else {
+				if (options.Motion == Dynamics::RandomWalk) {
+					vel.x += kick(rng) * seconds;
+					vel.y += kick(rng) * seconds;
+
+					float speed = std::sqrt(vel.x * vel.x + vel.y * vel.y);
+					if (speed > options.Speed * 2) {
+						vel.x *= options.Speed * 2 / speed;
+						vel.y *= options.Speed * 2 / speed;
+					}
+				}
+
+				loc.x += vel.x * seconds;
+				loc.y += vel.y * seconds;
+				Bounce(loc.x, vel.x);
+				Bounce(loc.y, vel.y);
+			}
+
+			root.ComponentToWorld.Rotation = Heading(vel);
+
+			// the replicated copy follows the actor
+			auto &rep = reps[motion.Rep];
+			rep.mActorLocation = { loc.x, loc.y, loc.z };
+			rep.mActorRotation = { 0.f, std::atan2(vel.y, vel.x) * 57.2957795f, 0.f };
+		}
+	}
+
+	// Reuses count random filler slots for new objects, like the garbage collector does
+	void Churn(int32_t count)
+	{
+		if (fillerEnd == fillerBegin) {
+			return;
+		}
+
+		std::uniform_int_distribution<int32_t> slot(fillerBegin, fillerEnd - 1), fillerClass(FirstFillerClass, ClassCount - 1);
+		for (int32_t n = 0; n < count; ++n) {
+			int32_t i = slot(rng);
+			auto &item = Item(i);
+			auto object = item.Object;
+
+			object->NamePrivate = FillerName(i);
+			object->ClassPrivate = &classes[fillerClass(rng)];
+			++item.SerialNumber;
+		}
+	}
+
+private:
+	struct Motion
+	{
+		int32_t Rep;
+		float CenterX, CenterY, Radius, Phase, AngularSpeed;
+	};
+
+	// object classes, the first ones are used by the fixed objects
+	enum
+	{
+		ClassClass,
+		MapManagerClass,
+		RepresentationManagerClass,
+		RepresentationClass,
+		VehicleClass,
+		SceneComponentClass,
+		FirstFillerClass,
+	};
+
+	static constexpr const char *ClassNames[] = {
+		"Class",
+		"FGMapManager",
+		"FGActorRepresentationManager",
+		"FGActorRepresentation",
+		"FGWheeledVehicle",
+		"SceneComponent",
+		"FGBuildableConveyorBelt",
+		"FGBuildableFoundation",
+		"FGBuildablePoleStackable",
+		"FGBuildableWall",
+		"FGItemPickup_Spawnable",
+		"StaticMeshComponent",
+		"Material",
+		"Texture2D",
+	};
+
+	static constexpr int32_t ClassCount = sizeof(ClassNames) / sizeof(ClassNames[0]);
+
+	void Build()
+	{
+		// names: None, the classes, the map manager, then filler
+		AddName("None");
+		for (auto name : ClassNames) {
+			AddName(name);
+		}
+		int32_t mapManagerName = AddName(options.MapManagerName.c_str());
+		firstFillerName = names.NumElements;
+		for (int32_t i = 0; i < options.FillerNames; ++i) {
+			AddName(("Object" + std::to_string(i)).c_str());
+		}
+
+		const int32_t actors = (std::max)(options.Actors, 0);
+		const int32_t moving = (int32_t)(actors * (std::min)((std::max)(options.MovingShare, 0.f), 1.f));
+		const int32_t filler = (std::max)(options.FillerObjects, 0);
+
+		classes.reset(new UObjectBase[ClassCount]());
+		reps.reset(new FGActorRepresentation[actors]());
+		actorObjects.reset(new AActor[moving]());
+		roots.reset(new USceneComponent[moving]());
+		fillerObjects.reset(new UObjectBase[filler]());
+		pointers.resize(actors);
+		motions.resize(moving);
+
+		ReserveObjects(ClassCount + 2 + actors + moving * 2 + filler);
+
+		for (int32_t i = 0; i < ClassCount; ++i) {
+			AddObject(&classes[i], ClassClass, { 1 + i, NAME_NO_NUMBER_INTERNAL });
+		}
+
+		std::uniform_real_distribution<float> pos(-Extent, Extent), unit(0.f, 1.f);
+		std::uniform_int_distribution<int32_t> type(0, 13), channel(0, 255);
+
+		// every n-th representation is backed by a moving actor
+		int32_t backed = 0;
+		for (int32_t i = 0; i < actors; ++i) {
+			auto &rep = reps[i];
+			AddObject(&rep, RepresentationClass, { 1 + RepresentationClass, NAME_EXTERNAL_TO_INTERNAL(i) });
+
+			rep.mActorLocation = { pos(rng), pos(rng), unit(rng) * 40e3f };
+			rep.mActorRotation = { 0.f, unit(rng) * 360.f - 180.f, 0.f };
+			rep.mRepresentationColor = { 255, channel(rng), channel(rng), 255 };
+			rep.mRepresentationType = (int8_t)type(rng);
+			rep.mShouldShowOnMap = true;
+			rep.mIsStatic = true;
+			pointers[i] = &rep;
+
+			if (backed < moving && (int64_t)backed * actors <= (int64_t)i * moving) {
+				AddActor(backed++, i);
+			}
+		}
+
+		representationManager.mReplicatedRepresentations = { pointers.data(), actors, actors };
+
+		std::uniform_int_distribution<int32_t> fillerClass(FirstFillerClass, ClassCount - 1);
+		fillerBegin = objects.ObjObjects.NumElements;
+		for (int32_t i = 0; i < filler; ++i) {
+			int32_t index = objects.ObjObjects.NumElements;
+			AddObject(&fillerObjects[i], fillerClass(rng), FillerName(index));
+		}
+		fillerEnd = objects.ObjObjects.NumElements;
+
+		// the level's actors come after the assets, name searches have to walk past them
+		AddObject(&mapManager, MapManagerClass, { mapManagerName, NAME_NO_NUMBER_INTERNAL });
+		AddObject(&representationManager, RepresentationManagerClass, { 1 + RepresentationManagerClass, NAME_EXTERNAL_TO_INTERNAL(0) });
+		mapManager.mActorRepresentationManager = &representationManager;
+
+		// velocities and headings as the dynamics want them
+		Step(0.f);
+	}
+
+	void AddActor(int32_t i, int32_t rep)
+	{
+		auto &actor = actorObjects[i];
+		auto &root = roots[i];
+		AddObject(&actor, VehicleClass, { 1 + VehicleClass, NAME_EXTERNAL_TO_INTERNAL(i) });
+
+		// components are objects too, the SDK only maps the fields after the header
+		AddObject((UObjectBase *)&root, SceneComponentClass, { 1 + SceneComponentClass, NAME_EXTERNAL_TO_INTERNAL(i) });
+
+		actor.RootComponent = &root;
+		reps[rep].mRealActor = &actor;
+		reps[rep].mIsStatic = false;
+
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+		float angle = unit(rng) * 6.2831853f;
+		float speed = options.Speed * (0.5f + unit(rng));
+
+		root.ComponentToWorld.Translation = { reps[rep].mActorLocation.x, reps[rep].mActorLocation.y, reps[rep].mActorLocation.z, 0.f };
+		root.ComponentToWorld.Scale3D = { 1.f, 1.f, 1.f, 0.f };
+		root.ComponentVelocity = { speed * std::cos(angle), speed * std::sin(angle), 0.f };
+		root.ComponentToWorld.Rotation = Heading(root.ComponentVelocity);
+
+		auto &motion = motions[i];
+		motion.Rep = rep;
+		motion.Radius = 5e3f + unit(rng) * 45e3f;
+		motion.CenterX = root.ComponentToWorld.Translation.x - motion.Radius;
+		motion.CenterY = root.ComponentToWorld.Translation.y;
+		motion.Phase = 0.f;
+		motion.AngularSpeed = speed / motion.Radius * (unit(rng) < 0.5f ? -1.f : 1.f);
+	}
+
+	// Entries are as long as their name, like the game allocates them
+	int32_t AddName(const char *text)
+	{
+		int32_t index = names.NumElements;
+		int32_t chunk = index / TNameEntryArray::ElementsPerChunk;
+
+		if (chunk >= names.NumChunks) {
+			nameChunks.emplace_back(new FNameEntry *[TNameEntryArray::ElementsPerChunk]());
+			names.Chunks[chunk] = nameChunks.back().get();
+			names.NumChunks = chunk + 1;
+		}
+
+		size_t len = std::strlen(text);
+		size_t size = (offsetof(FNameEntry, Name) + len + 1 + 7) & ~(size_t)7;
+		if (nameUsed + size > NameBlockSize) {
+			nameBlocks.emplace_back(new char[NameBlockSize]());
+			nameUsed = 0;
+		}
+
+		auto entry = (FNameEntry *)(nameBlocks.back().get() + nameUsed);
+		nameUsed += size;
+
+		entry->Index = index << NAME_INDEX_SHIFT;
+		std::memcpy(entry->Name, text, len + 1);
+
+		names.Chunks[chunk][index % TNameEntryArray::ElementsPerChunk] = entry;
+		names.NumElements = index + 1;
+		return index;
+	}
+
+	void ReserveObjects(int32_t count)
+	{
+		constexpr int32_t PerChunk = FChunkedFixedUObjectArray::NumElementsPerChunk;
+		int32_t chunks = (std::max)((count + PerChunk - 1) / PerChunk, 1);
+
+		objectChunks.resize(chunks);
+		chunkTable.resize(chunks);
+		for (int32_t i = 0; i < chunks; ++i) {
+			objectChunks[i].reset(new FUObjectItem[PerChunk]());
+			chunkTable[i] = objectChunks[i].get();
+		}
+
+		auto &array = objects.ObjObjects;
+		array.Objects = chunkTable.data();
+		array.MaxElements = chunks * PerChunk;
+		array.NumElements = 0;
+		array.MaxChunks = chunks;
+		array.NumChunks = chunks;
+	}
+
+	void AddObject(UObjectBase *object, int32_t classIndex, FName name)
+	{
+		int32_t index = objects.ObjObjects.NumElements++;
+
+		object->InternalIndex = index;
+		object->ClassPrivate = &classes[classIndex];
+		object->NamePrivate = name;
+
+		auto &item = Item(index);
+		item.Object = object;
+		item.ClusterRootIndex = -1;
+		item.SerialNumber = 1;
+	}
+
+	FUObjectItem &Item(int32_t index)
+	{
+		return chunkTable[index / FChunkedFixedUObjectArray::NumElementsPerChunk][index % FChunkedFixedUObjectArray::NumElementsPerChunk];
+	}
+
+	// "Object123_4" style names, spread over the filler names
+	FName FillerName(int32_t index)
+	{
+		if (options.FillerNames <= 0) {
+			return { 0, NAME_EXTERNAL_TO_INTERNAL(index) };
+		}
+
+		std::uniform_int_distribution<int32_t> name(0, options.FillerNames - 1);
+		return { firstFillerName + name(rng), NAME_EXTERNAL_TO_INTERNAL(index) };
+	}
+
+	static void Bounce(float &x, float &v)
+	{
+		if (x > Extent) {
+			x = 2 * Extent - x;
+			v = -v;
+		} else if (x < -Extent) {
+			x = -2 * Extent - x;
+			v = -v;
+		}
+	}
+
+	// yaw only quaternion facing along v
+	static Vector4 Heading(const Vector3 &v)
+	{
+		float half = std::atan2(v.y, v.x) * 0.5f;
+		return { 0.f, 0.f, std::sin(half), std::cos(half) };
+	}
+
+	static constexpr size_t NameBlockSize = 256 * 1024;
+
+	Options options;
+	std::mt19937 rng;
+
+	TNameEntryArray names{};
+	std::vector<std::unique_ptr<FNameEntry *[]>> nameChunks;
+	std::vector<std::unique_ptr<char[]>> nameBlocks;
+	size_t nameUsed = NameBlockSize;
+	int32_t firstFillerName = 0;
+
+	FUObjectArray objects{};
+	std::vector<std::unique_ptr<FUObjectItem[]>> objectChunks;
+	std::vector<FUObjectItem *> chunkTable;
+	int32_t fillerBegin = 0, fillerEnd = 0;
+
+	std::unique_ptr<UObjectBase[]> classes;
+	FGMapManager mapManager{};
+	FGActorRepresentationManager representationManager{};
+	std::unique_ptr<FGActorRepresentation[]> reps;
+	std::vector<FGActorRepresentation *> pointers;
+	std::unique_ptr<AActor[]> actorObjects;
+	std::unique_ptr<USceneComponent[]> roots;
+	std::unique_ptr<UObjectBase[]> fillerObjects;
+	std::vector<Motion> motions;
+};
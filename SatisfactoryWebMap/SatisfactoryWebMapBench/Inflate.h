@@ -0,0 +1,286 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#include "Deflate.h"
+
+// DEFLATE (RFC 1951) decompressor with the gzip and zlib wrappers, written from the RFC
+// independently of Deflate.h, so the bench can check that what the server sends decodes.
+// Slow and strict: any malformed stream, bad checksum or trailing byte fails.
+namespace inflate {
+
+namespace detail {
+
+struct BitReader
+{
+	const uint8_t *data;
+	size_t size, pos = 0;
+	uint32_t bits = 0;
+	int count = 0;
+	bool overrun = false;
+
+	uint32_t Get(int n)
+	{
+		while (count < n) {
+			if (pos >= size) {
+				overrun = true;
+				return 0;
+			}
+			bits |= (uint32_t)data[pos++] << count;
+			count += 8;
+		}
+		uint32_t v = bits & ((1u << n) - 1);
+		bits >>= n;
+		count -= n;
+		return v;
+	}
+
+	void Align()
+	{
+		bits = 0;
+		count = 0;
+	}
+};
+
+// canonical code by count of each length, decoded a bit at a time
+struct Huffman
+{
+	uint16_t count[16] = {};
+	uint16_t symbols[288] = {};
+
+	bool Build(const uint8_t *lengths, int n)
+	{
+		uint16_t offsets[16] = {};
+		for (int i = 0; i < n; ++i) {
+			count[lengths[i]]++;
+		}
+		count[0] = 0;
+
+		int left = 1;
+		for (int len = 1; len < 16; ++len) {
+			left = (left << 1) - count[len];
+			if (left < 0) {
+				return false;
+			}
+			offsets[len] = (uint16_t)(len == 1 ? 0 : offsets[len - 1] + count[len - 1]);
+		}
+
+		for (int i = 0; i < n; ++i) {
+			if (lengths[i] != 0) {
+				symbols[offsets[lengths[i]]++] = (uint16_t)i;
+			}
+		}
+		return true;
+	}
+
+	int Decode(BitReader &br) const
+	{
+		int code = 0, first = 0, index = 0;
+		for (int len = 1; len < 16; ++len) {
+			code |= (int)br.Get(1);
+			if (br.overrun) {
+				return -1;
+			}
+			if (code - first < count[len]) {
+				return symbols[index + code - first];
+			}
+			index += count[len];
+			first = (first + count[len]) << 1;
+			code <<= 1;
+		}
+		return -1;
+	}
+};
+
+const uint16_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const uint8_t LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const uint16_t DistBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const uint8_t DistExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+inline bool Codes(BitReader &br, const Huffman &lit, const Huffman &dist, std::string &out)
+{
+	for (;;) {
+		int symbol = lit.Decode(br);
+		if (symbol < 0 || symbol > 285) {
+			return false;
+		}
+		if (symbol < 256) {
+			out += (char)symbol;
+			continue;
+		}
+		if (symbol == 256) {
+			return true;
+		}
+
+		symbol -= 257;
+		size_t len = LengthBase[symbol] + br.Get(LengthExtra[symbol]);
+		int d = dist.Decode(br);
+		if (d < 0 || d > 29) {
+			return false;
+		}
+		size_t distance = DistBase[d] + br.Get(DistExtra[d]);
+		if (br.overrun || distance > out.size()) {
+			return false;
+		}
+
+		size_t from = out.size() - distance;
+		for (size_t i = 0; i < len; ++i) {
+			out += out[from + i];
+		}
+	}
+}
+
+inline bool Dynamic(BitReader &br, std::string &out)
+{
+	static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	int numLit = (int)br.Get(5) + 257, numDist = (int)br.Get(5) + 1, numCl = (int)br.Get(4) + 4;
+	if (numLit > 286 || numDist > 30) {
+		return false;
+	}
+
+	uint8_t clLen[19] = {};
+	for (int i = 0; i < numCl; ++i) {
+		clLen[order[i]] = (uint8_t)br.Get(3);
+	}
+	Huffman cl;
+	if (!cl.Build(clLen, 19)) {
+		return false;
+	}
+
+	uint8_t lengths[286 + 30] = {};
+	for (int i = 0; i < numLit + numDist;) {
+		int symbol = cl.Decode(br);
+		if (symbol < 0) {
+			return false;
+		}
+		if (symbol < 16) {
+			lengths[i++] = (uint8_t)symbol;
+			continue;
+		}
+
+		uint8_t value = 0;
+		int repeat;
+		if (symbol == 16) {
+			if (i == 0) {
+				return false;
+			}
+			value = lengths[i - 1];
+			repeat = 3 + (int)br.Get(2);
+		} else if (symbol == 17) {
+			repeat = 3 + (int)br.Get(3);
+		} else {
+			repeat = 11 + (int)br.Get(7);
+		}
+		if (i + repeat > numLit + numDist) {
+			return false;
+		}
+		while (repeat--) {
+			lengths[i++] = value;
+		}
+	}
+
+	Huffman lit, dist;
+	return !br.overrun && lengths[256] != 0 && lit.Build(lengths, numLit) && dist.Build(lengths + numLit, numDist) &&
+		Codes(br, lit, dist, out);
+}
+
+inline bool Fixed(BitReader &br, std::string &out)
+{
+	uint8_t lengths[288 + 30];
+	for (int i = 0; i < 288; ++i) {
+		lengths[i] = (uint8_t)(i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8);
+	}
+	for (int i = 288; i < 288 + 30; ++i) {
+		lengths[i] = 5;
+	}
+
+	Huffman lit, dist;
+	lit.Build(lengths, 288);
+	dist.Build(lengths + 288, 30);
+	return Codes(br, lit, dist, out);
+}
+
+inline bool Stored(BitReader &br, std::string &out)
+{
+	br.Align();
+	if (br.pos + 4 > br.size) {
+		return false;
+	}
+
+	const uint8_t *p = br.data + br.pos;
+	uint16_t len = (uint16_t)(p[0] | p[1] << 8), nlen = (uint16_t)(p[2] | p[3] << 8);
+	if ((uint16_t)~len != nlen || br.pos + 4 + len > br.size) {
+		return false;
+	}
+
+	out.append((const char *)p + 4, len);
+	br.pos += 4 + len;
+	return true;
+}
+
+}
+
+// Raw DEFLATE stream, used is set to the bytes it took
+inline bool Decompress(const void *data, size_t size, std::string &out, size_t *used = nullptr)
+{
+	using namespace detail;
+
+	BitReader br{ (const uint8_t *)data, size };
+	out.clear();
+
+	for (bool final = false; !final;) {
+		final = br.Get(1) != 0;
+		uint32_t type = br.Get(2);
+
+		bool ok = type == 0 ? Stored(br, out) : type == 1 ? Fixed(br, out) : type == 2 ? Dynamic(br, out) : false;
+		if (!ok || br.overrun) {
+			return false;
+		}
+	}
+
+	if (used) {
+		*used = br.pos;
+	}
+	return true;
+}
+
+// Content-Encoding: gzip, the single member deflate::Gzip writes
+inline bool Gunzip(const std::string &data, std::string &out)
+{
+	if (data.size() < 18 || (uint8_t)data[0] != 0x1f || (uint8_t)data[1] != 0x8b || data[2] != 8 || data[3] != 0) {
+		return false;
+	}
+
+	size_t used = 0;
+	if (!Decompress(data.data() + 10, data.size() - 10, out, &used) || 10 + used + 8 != data.size()) {
+		return false;
+	}
+
+	auto le32 = [&](size_t at) {
+		const uint8_t *p = (const uint8_t *)data.data() + at;
+		return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+	};
+	return le32(10 + used) == deflate::Crc32(out.data(), out.size()) && le32(10 + used + 4) == (uint32_t)out.size();
+}
+
+// Content-Encoding: deflate (zlib)
+inline bool Unzlib(const std::string &data, std::string &out)
+{
+	if (data.size() < 6 || (data[0] & 0x0f) != 8 || (((uint8_t)data[0] << 8) | (uint8_t)data[1]) % 31 != 0) {
+		return false;
+	}
+
+	size_t used = 0;
+	if (!Decompress(data.data() + 2, data.size() - 2, out, &used) || 2 + used + 4 != data.size()) {
+		return false;
+	}
+
+	const uint8_t *p = (const uint8_t *)data.data() + 2 + used;
+	uint32_t adler = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+	return adler == deflate::Adler32(out.data(), out.size());
+}
+
+}
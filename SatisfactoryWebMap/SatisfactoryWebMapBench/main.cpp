@@ -0,0 +1,786 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "Bench.h"
+#include "Config.h"
+#include "Snapshot.h"
+#include "GeoJsonWriter.h"
+#include "TrailStore.h"
+#include "VectorTile.h"
+#include "MemorySource.h"
+#include "NameTable.h"
+#include "ObjectScanner.h"
+#include "ObjectIndex.h"
+#include "ActorSampler.h"
+#include "ActorsBinary.h"
+#include "Deflate.h"
+#include "FakeGame.h"
+#include "Inflate.h"
+
+#include "../SatisfactoryWebMap/base64.h"
+
+// the game globals the scan code reads, pointed into the capture or a FakeGame
+const TNameEntryArray *Names_0 = nullptr;
+const FUObjectArray *GUObjectArray = nullptr;
+
+// Every replaceable allocation function goes through CountedAlloc and CountedFree, so nothing
+// the measured code allocates is missed and every delete frees the way its new allocated
+namespace {
+
+void *CountedAlloc(size_t size, size_t alignment = 0) noexcept
+{
+	AllocStats::Count.fetch_add(1, std::memory_order_relaxed);
+	AllocStats::Bytes.fetch_add(size, std::memory_order_relaxed);
+
+	size = size ? size : 1;
+	if (alignment <= alignof(std::max_align_t)) {
+		return std::malloc(size);
+	}
+#ifdef _MSC_VER
+	return _aligned_malloc(size, alignment);
+#else
+	return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+}
+
+// Kept out of line: inlined into a replaced operator delete and from there into its caller,
+// GCC pairs the std::free below with the operator new the caller called and warns
+// (-Wmismatched-new-delete), not knowing that operator new is CountedAlloc's malloc
+#ifdef _MSC_VER
+__declspec(noinline)
+#else
+__attribute__((noinline))
+#endif
+void CountedFree(void *p, size_t alignment = 0) noexcept
+{
+#ifdef _MSC_VER
+	if (alignment > alignof(std::max_align_t)) {
+		_aligned_free(p);
+		return;
+	}
+#else
+	(void)alignment;
+#endif
+	std::free(p);
+}
+
+void *CountedNew(size_t size, size_t alignment = 0)
+{
+	if (auto p = CountedAlloc(size, alignment)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+}
+
+void *operator new(size_t size)
+{
+	return CountedNew(size);
+}
+
+void *operator new[](size_t size)
+{
+	return CountedNew(size);
+}
+
+void *operator new(size_t size, std::align_val_t al)
+{
+	return CountedNew(size, (size_t)al);
+}
+
+void *operator new[](size_t size, std::align_val_t al)
+{
+	return CountedNew(size, (size_t)al);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	return CountedAlloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return CountedAlloc(size);
+}
+
+void *operator new(size_t size, std::align_val_t al, const std::nothrow_t &) noexcept
+{
+	return CountedAlloc(size, (size_t)al);
+}
+
+void *operator new[](size_t size, std::align_val_t al, const std::nothrow_t &) noexcept
+{
+	return CountedAlloc(size, (size_t)al);
+}
+
+void operator delete(void *p) noexcept
+{
+	CountedFree(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	CountedFree(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	CountedFree(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+	CountedFree(p);
+}
+
+void operator delete(void *p, std::align_val_t al) noexcept
+{
+	CountedFree(p, (size_t)al);
+}
+
+void operator delete[](void *p, std::align_val_t al) noexcept
+{
+	CountedFree(p, (size_t)al);
+}
+
+void operator delete(void *p, size_t, std::align_val_t al) noexcept
+{
+	CountedFree(p, (size_t)al);
+}
+
+void operator delete[](void *p, size_t, std::align_val_t al) noexcept
+{
+	CountedFree(p, (size_t)al);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+	CountedFree(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+	CountedFree(p);
+}
+
+void operator delete(void *p, std::align_val_t al, const std::nothrow_t &) noexcept
+{
+	CountedFree(p, (size_t)al);
+}
+
+void operator delete[](void *p, std::align_val_t al, const std::nothrow_t &) noexcept
+{
+	CountedFree(p, (size_t)al);
+}
+
+// The DOM based serializer the server used before GeoJsonWriter, kept as the reference output
+namespace legacy {
+
+nlohmann::json ActorToFeature(const ActorState &actor)
+{
+	using json = nlohmann::json;
+
+	json j;
+
+	j["type"] = "Feature";
+	j["properties"] =
+	{
+		{  "type", actor.Type                                         },
+		{ "index", actor.Index                                        },
+		{ "color", std::vector<int32_t>(actor.Color, actor.Color + 4) },
+	};
+
+	j["geometry"]["type"] = "Point";
+	j["geometry"]["coordinates"] = std::vector<float>(actor.Location, actor.Location + 3);
+
+	j["properties"]["ang"] = std::vector<float>(actor.Rotation, actor.Rotation + 3);
+	if (actor.HasVelocity) {
+		j["properties"]["vel"] = std::vector<float>(actor.Velocity, actor.Velocity + 3);
+	}
+
+	return j;
+}
+
+std::string SerializeActors(const Snapshot &snapshot)
+{
+	using json = nlohmann::json;
+
+	std::vector<json> features;
+	features.reserve(snapshot.Actors.size());
+
+	for (const auto &actor : snapshot.Actors) {
+		features.push_back(ActorToFeature(actor));
+	}
+
+	return json({
+		{ "status", "ok" },
+		{ "type", "FeatureCollection" },
+		{ "features", features },
+	}).dump();
+}
+
+}
+
+void MakeSnapshot(Snapshot &snapshot, size_t count)
+{
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> pos(-375e3f, 375e3f), ang(-180.f, 180.f), vel(-3000.f, 3000.f);
+
+	snapshot.Seq = 1;
+	snapshot.Valid = true;
+	snapshot.Actors.resize(count);
+
+	for (size_t i = 0; i < count; ++i) {
+		auto &actor = snapshot.Actors[i];
+		actor = {};
+		actor.Index = (int32_t)i;
+		actor.Type = (int8_t)(rng() % 14);
+		for (int k = 0; k < 3; ++k) {
+			actor.Location[k] = pos(rng);
+			actor.Rotation[k] = ang(rng);
+		}
+		actor.HasVelocity = i % 4 == 0;
+		if (actor.HasVelocity) {
+			for (int k = 0; k < 3; ++k) {
+				actor.Velocity[k] = vel(rng);
+			}
+		}
+		actor.Color[0] = 255;
+		actor.Color[1] = (int32_t)(rng() % 256);
+		actor.Color[2] = 0;
+		actor.Color[3] = 255;
+		actor.Hash = HashActorState(actor);
+	}
+}
+
+// The scan and snapshot path on a capture taken with /api/capture
+bool BenchCapture(const std::string &path, const std::string &mapManagerName, std::vector<BenchResult> &results)
+{
+	MemoryDump dump;
+	if (!dump.Load(path)) {
+		std::fprintf(stderr, "Unable to load %s\n", path.c_str());
+		return false;
+	}
+
+	Names_0 = dump.Root<TNameEntryArray>("names");
+	GUObjectArray = dump.Root<FUObjectArray>("objects");
+	std::printf("%s: %zu bytes captured\n", path.c_str(), dump.Bytes());
+
+	WorkerPool pool((std::max)((int)std::thread::hardware_concurrency(), 1));
+
+	results.push_back(RunBench("capture/names_refresh", [&] {
+		NameTable(dump).Refresh();
+	}));
+
+	NameTable names(dump);
+	names.Refresh();
+
+	ObjectScanner scanner(dump, names, pool);
+	auto mapManager = (const FGMapManager *)scanner.FindFirstByName(mapManagerName);
+	if (mapManager == nullptr) {
+		std::fprintf(stderr, "No %s in the capture\n", mapManagerName.c_str());
+		return false;
+	}
+
+	results.push_back(RunBench("capture/find_by_name", [&] {
+		scanner.FindFirstByName(mapManagerName);
+	}));
+
+	results.push_back(RunBench("capture/index_cold", [&] {
+		ObjectIndex(dump, names, pool).Refresh();
+	}));
+
+	ObjectIndex index(dump, names, pool);
+	index.Refresh();
+	results.push_back(RunBench("capture/index_warm", [&] {
+		index.Refresh();
+	}));
+
+	Snapshot snapshot;
+	std::string error, buffer;
+
+	results.push_back(RunBench("capture/read_actors", [&] {
+		snapshot.Actors.clear();
+		ReadActors(dump, mapManager, snapshot.Actors, error);
+	}));
+
+	snapshot.Valid = true;
+	results.push_back(RunBench("capture/read_actors+json", [&] {
+		snapshot.Actors.clear();
+		ReadActors(dump, mapManager, snapshot.Actors, error);
+
+		buffer.clear();
+		GeoJsonWriter(buffer).FeatureCollection(snapshot);
+	}));
+
+	return true;
+}
+
+// The setup() and snapshot thread paths on a made up world, read in place
+bool BenchFakeGame(int32_t actors, int32_t objects, std::vector<BenchResult> &results)
+{
+	FakeGame::Options options;
+	options.Actors = actors;
+	options.FillerObjects = objects;
+
+	FakeGame game(options);
+	game.Install();
+
+	ProcessMemory memory;
+	WorkerPool pool((std::max)((int)std::thread::hardware_concurrency(), 1));
+
+	NameTable names(memory);
+	names.Refresh();
+
+	ObjectScanner scanner(memory, names, pool);
+	if (scanner.FindFirstByName(options.MapManagerName) != (const UObjectBase *)game.MapManager()) {
+		std::fprintf(stderr, "FindFirstByName missed the map manager of the fake game\n");
+		return false;
+	}
+
+	BenchParams params{ { "actors", actors }, { "objects", game.ObjectCount() } };
+
+	std::vector<const UObjectBase *> live;
+	for (int32_t i = 0; i < GUObjectArray->ObjObjects.NumElements; ++i) {
+		if (auto object = GUObjectArray->ObjObjects[i].Object) {
+			live.push_back(object);
+		}
+	}
+
+	size_t next = 0;
+	std::string name;
+
+	// the game's own lookup, one name after the other
+	results.push_back(RunBench("fname/sdk_to_string", params, [&] {
+		name = live[next++ % live.size()]->NamePrivate.ToString();
+	}));
+
+	results.push_back(RunBench("fname/name_table_append", params, [&] {
+		name.clear();
+		names.Append(name, live[next++ % live.size()]->NamePrivate);
+	}));
+
+	// FindMapManager before ObjectScanner: every name turned into a string and compared
+	results.push_back(RunBench("find_by_name/string_compare", params, [&] {
+		const auto &array = GUObjectArray->ObjObjects;
+		for (int32_t i = 0; i < array.NumElements; ++i) {
+			auto object = array[i].Object;
+			if (object != nullptr && object->NamePrivate == options.MapManagerName) {
+				break;
+			}
+		}
+	}));
+
+	results.push_back(RunBench("find_by_name/scanner", params, [&] {
+		scanner.FindFirstByName(options.MapManagerName);
+	}));
+
+	ObjectIndex index(memory, names, pool);
+	index.Refresh();
+	results.push_back(RunBench("object_index/churn_100", params, [&] {
+		game.Churn(100);
+		index.Refresh();
+	}));
+
+	results.push_back(RunBench("fake_game/step", params, [&] {
+		game.Step(0.1f);
+	}));
+
+	Snapshot snapshot;
+	std::string error, buffer;
+
+	results.push_back(RunBench("actors/read", params, [&] {
+		snapshot.Actors.clear();
+		ReadActors(memory, game.MapManager(), snapshot.Actors, error);
+	}));
+
+	snapshot.Valid = true;
+	results.push_back(RunBench("actors/read+json", params, [&] {
+		snapshot.Actors.clear();
+		ReadActors(memory, game.MapManager(), snapshot.Actors, error);
+
+		buffer.clear();
+		GeoJsonWriter(buffer).FeatureCollection(snapshot);
+	}));
+
+	// a 10 Hz snapshot thread, reading everything or only what may have moved
+	results.push_back(RunBench("actors/step+read", params, [&] {
+		game.Step(0.1f);
+		snapshot.Actors.clear();
+		ReadActors(memory, game.MapManager(), snapshot.Actors, error);
+	}));
+
+	ActorScheduler scheduler(std::chrono::milliseconds(2000));
+	auto now = ActorScheduler::Clock::now();
+	results.push_back(RunBench("actors/step+adaptive", params, [&] {
+		game.Step(0.1f);
+		now += std::chrono::milliseconds(100);
+		snapshot.Actors.clear();
+		scheduler.Sample(memory, game.MapManager(), now, snapshot.Actors, error);
+	}));
+
+	const auto &sampled = scheduler.LastStats();
+	std::printf("actors/step+adaptive: %zu of %zu actors read, %zu static\n", sampled.Read, sampled.Actors, sampled.Static);
+
+	// a second of the world going by, as the history thread sees it
+	TrailStore trails;
+	snapshot.Time = 0;
+	results.push_back(RunBench("history/step+read+record", params, [&] {
+		game.Step(1.f);
+		snapshot.Actors.clear();
+		ReadActors(memory, game.MapManager(), snapshot.Actors, error);
+
+		snapshot.Time += 1000;
+		trails.Record(snapshot);
+	}));
+
+	return true;
+}
+
+// What the GUI keeps of every actor
+struct ClientActor
+{
+	int8_t Type;
+	float Location[3];
+};
+
+// The /api/actors serializers and what a client does with their output
+bool BenchActorsJson(size_t count, std::vector<BenchResult> &results)
+{
+	using json = nlohmann::json;
+
+	Snapshot snapshot;
+	MakeSnapshot(snapshot, count);
+
+	std::string writer;
+	GeoJsonWriter(writer).FeatureCollection(snapshot);
+	if (writer != legacy::SerializeActors(snapshot)) {
+		std::fprintf(stderr, "GeoJsonWriter output differs from nlohmann for %zu actors\n", count);
+		return false;
+	}
+
+	BenchParams params{ { "actors", (int64_t)count } };
+
+	results.push_back(RunBench("actors_json/nlohmann", params, [&] {
+		auto body = legacy::SerializeActors(snapshot);
+	}));
+
+	std::string buffer;
+	results.push_back(RunBench("actors_json/writer", params, [&] {
+		buffer.clear();
+		GeoJsonWriter(buffer).FeatureCollection(snapshot);
+	}));
+
+	std::vector<ClientActor> items;
+
+	// the GUI before the binary stream: parse the GeoJSON, pick out type and position
+	results.push_back(RunBench("client/geojson_parse", params, [&] {
+		auto j = json::parse(writer);
+
+		items.clear();
+		for (const auto &feature : j["features"]) {
+			const auto &coordinates = feature["geometry"]["coordinates"];
+			items.push_back({ feature["properties"]["type"].get<int8_t>(),
+				{ coordinates[0].get<float>(), coordinates[1].get<float>(), coordinates[2].get<float>() } });
+		}
+	}));
+
+	// UIWindow::UpdateActors on one /api/actors/stream event
+	ActorsBinaryWriter binary(snapshot.Actors.size());
+	for (const auto &actor : snapshot.Actors) {
+		binary.Add(actor.Index, (uint8_t)actor.Type, actor.Location, actor.Rotation,
+			actor.HasVelocity ? actor.Velocity : nullptr, actor.Color);
+	}
+	auto event = base64_encode(binary.Finish(snapshot.Seq, snapshot.Time, snapshot.Valid));
+
+	results.push_back(RunBench("client/binary_decode", params, [&] {
+		auto data = base64_decode(event);
+
+		ActorsBinary actors;
+		DecodeActorsBinary(data.data(), data.size(), actors);
+
+		items.clear();
+		for (size_t i = 0; i < actors.Count; ++i) {
+			const float *pos = &actors.Position[i * 3];
+			items.push_back({ (int8_t)actors.Type[i], { pos[0], pos[1], pos[2] } });
+		}
+	}));
+
+	// /api/actors?bbox= of a client zoomed in on a 50 km square
+	const float box[4] = { -25e3f, -25e3f, 25e3f, 25e3f };
+	std::vector<const ActorState *> selected;
+
+	results.push_back(RunBench("actors_bbox/build_grid", params, [&] {
+		snapshot.Grid.Build(snapshot.Actors);
+	}));
+
+	results.push_back(RunBench("actors_bbox/scan", params, [&] {
+		selected.clear();
+		for (const auto &actor : snapshot.Actors) {
+			const auto &loc = actor.Location;
+			if (loc[0] >= box[0] && loc[1] >= box[1] && loc[0] <= box[2] && loc[1] <= box[3]) {
+				selected.push_back(&actor);
+			}
+		}
+		buffer.clear();
+		GeoJsonWriter(buffer).FeatureCollection(snapshot, selected);
+	}));
+
+	results.push_back(RunBench("actors_bbox/grid", params, [&] {
+		snapshot.Grid.Query(snapshot.Actors, box, SpatialGrid::AllTypes, selected);
+		buffer.clear();
+		GeoJsonWriter(buffer).FeatureCollection(snapshot, selected);
+	}));
+
+	// /api/clusters of the whole map at the zoom the page opens with
+	const float everywhere[4] = { -1e9f, -1e9f, 1e9f, 1e9f };
+	std::vector<const ClusterIndex::Cluster *> clusters;
+
+	results.push_back(RunBench("clusters/build", params, [&] {
+		snapshot.ClusterLevels.Build(snapshot.Actors);
+	}));
+
+	results.push_back(RunBench("clusters/query", params, [&] {
+		snapshot.ClusterLevels.Query(-10, everywhere, clusters);
+		buffer.clear();
+		GeoJsonWriter(buffer).Clusters(snapshot, -10, clusters);
+	}));
+
+	// every /tiles/actors tile of the map at zoom -9, encoded from scratch
+	results.push_back(RunBench("tiles/encode_zoom-9", params, [&] {
+		size_t bytes = 0;
+		for (int y = -3; y < 3; ++y) {
+			for (int x = -3; x < 4; ++x) {
+				float tileBox[4];
+				mvt::TileBounds(-9, x, y, tileBox);
+				snapshot.Grid.Query(snapshot.Actors, tileBox, SpatialGrid::AllTypes, selected);
+				bytes += mvt::EncodeActorTile(-9, x, y, selected).size();
+			}
+		}
+	}));
+
+	return true;
+}
+
+// Gzip and Zlib at every level decode back to their input, checked on random bytes, non-ASCII
+// text and a snapshot body, then the speed of compressing /api/actors
+bool BenchDeflate(std::vector<BenchResult> &results)
+{
+	std::mt19937 rng(1);
+	auto randomBytes = [&](size_t size) {
+		std::string bytes(size, '\0');
+		for (auto &c : bytes) {
+			c = (char)(rng() & 0xff);
+		}
+		return bytes;
+	};
+
+	// {"msg":"Fabrik Müller 工厂 Завод"} in UTF-8, its bytes >= 0x80 take 9 bit fixed codes
+	std::string text = "{\"msg\":\"Fabrik M\xc3\xbc" "ller \xe5\xb7\xa5\xe5\x8e\x82 \xd0\x97\xd0\xb0\xd0\xb2\xd0\xbe\xd0\xb4\"}";
+	std::string mixed;
+	while (mixed.size() < 80000) {
+		mixed += text + randomBytes(rng() % 64) + std::string(rng() % 32, 'a');
+	}
+
+	Snapshot snapshot;
+	MakeSnapshot(snapshot, 1000);
+	std::string body;
+	GeoJsonWriter(body).FeatureCollection(snapshot);
+
+	std::vector<std::pair<std::string, std::string>> inputs = {
+		{ "empty", "" },
+		{ "random-61", randomBytes(61) },
+		{ "random-70000", randomBytes(70000) },
+		{ "text", text },
+		{ "mixed", mixed },
+		{ "geojson", body },
+	};
+
+	for (const auto &input : inputs) {
+		for (int level = 0; level <= 9; ++level) {
+			std::string decoded;
+			if (!inflate::Gunzip(deflate::Gzip(input.second, level), decoded) || decoded != input.second) {
+				std::fprintf(stderr, "deflate::Gzip of %s at level %d does not decode back\n", input.first.c_str(), level);
+				return false;
+			}
+			if (!inflate::Unzlib(deflate::Zlib(input.second, level), decoded) || decoded != input.second) {
+				std::fprintf(stderr, "deflate::Zlib of %s at level %d does not decode back\n", input.first.c_str(), level);
+				return false;
+			}
+		}
+	}
+
+	BenchParams params{ { "bytes", (int64_t)body.size() } };
+	for (int level : { 1, 6, 9 }) {
+		results.push_back(RunBench("deflate/gzip_geojson_level-" + std::to_string(level), params, [&] {
+			auto compressed = deflate::Gzip(body, level);
+		}));
+	}
+	return true;
+}
+
+// Config::Load of a file that sets every key
+bool BenchConfig(std::vector<BenchResult> &results)
+{
+	const std::string path = "SatisfactoryWebMapBench.config.json";
+
+	auto config = Config::Load("");
+	config.Root = "web";
+	config.Save(path);
+
+	results.push_back(RunBench("config/load", [&] {
+		Config::Load(path);
+	}));
+
+	std::remove(path.c_str());
+	return true;
+}
+
+// Samples a fake game for seconds while another thread keeps moving its actors and reusing
+// object slots, checking every sample
+bool SoakFakeGame(int32_t actors, int32_t objects, int seconds)
+{
+	using clock = std::chrono::steady_clock;
+
+	FakeGame::Options options;
+	options.Actors = actors;
+	options.FillerObjects = objects;
+	options.Motion = FakeGame::Dynamics::RandomWalk;
+	FakeGame game(options);
+	game.Install();
+
+	ProcessMemory memory;
+	WorkerPool pool((std::max)((int)std::thread::hardware_concurrency(), 1));
+	NameTable names(memory);
+	ObjectScanner scanner(memory, names, pool);
+	ObjectIndex index(memory, names, pool);
+
+	std::atomic<bool> stop = false;
+	std::thread mover([&] {
+		while (!stop) {
+			game.Step(0.01f);
+			game.Churn(1000);
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	});
+
+	Snapshot snapshot;
+	snapshot.Valid = true;
+	std::string error, buffer;
+
+	uint64_t samples = 0;
+	auto worst = clock::duration::zero();
+	bool ok = true;
+
+	auto end = clock::now() + std::chrono::seconds(seconds);
+	while (ok && clock::now() < end) {
+		auto start = clock::now();
+
+		index.Refresh();
+		auto mapManager = (const FGMapManager *)scanner.FindFirstByName(options.MapManagerName);
+
+		snapshot.Actors.clear();
+		if (mapManager != game.MapManager() || !ReadActors(memory, mapManager, snapshot.Actors, error)) {
+			std::fprintf(stderr, "sample %llu: no map manager or actors (%s)\n", (unsigned long long)samples, error.c_str());
+			ok = false;
+		} else if ((int32_t)snapshot.Actors.size() != actors || index.Size() != game.ObjectCount()) {
+			std::fprintf(stderr, "sample %llu: %zu actors, %d objects indexed\n", (unsigned long long)samples, snapshot.Actors.size(), index.Size());
+			ok = false;
+		}
+
+		buffer.clear();
+		GeoJsonWriter(buffer).FeatureCollection(snapshot);
+
+		worst = (std::max)(worst, clock::now() - start);
+		++samples;
+	}
+
+	stop = true;
+	mover.join();
+
+	std::printf("soak/%d: %llu samples, worst %.1f ms, %s\n", actors, (unsigned long long)samples,
+		std::chrono::duration<double, std::milli>(worst).count(), ok ? "ok" : "FAILED");
+	return ok;
+}
+
+// SatisfactoryWebMapBench [options] [capture.bin [mapmanager name]]
+//   --actors <count>    fake game actors, 100 and 10000 by default, up to 1000000
+//   --objects <count>   other objects in the fake game, 100000 by default
+//   --json <file>       also write the results to file, for comparing releases
+//   --soak <seconds>    sample a moving fake game instead of benchmarking
+int main(int argc, char **argv)
+{
+	std::vector<int32_t> actorCounts, objectCounts;
+	std::vector<std::string> positional;
+	std::string jsonPath;
+	int soak = 0;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--actors" && hasValue) {
+			actorCounts.push_back(std::atoi(argv[++i]));
+		} else if (arg == "--objects" && hasValue) {
+			objectCounts.push_back(std::atoi(argv[++i]));
+		} else if (arg == "--json" && hasValue) {
+			jsonPath = argv[++i];
+		} else if (arg == "--soak" && hasValue) {
+			soak = std::atoi(argv[++i]);
+		} else if (arg.compare(0, 2, "--") == 0) {
+			std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+			return 1;
+		} else {
+			positional.push_back(arg);
+		}
+	}
+
+	if (soak > 0) {
+		return SoakFakeGame(actorCounts.empty() ? 10000 : actorCounts[0], objectCounts.empty() ? 100000 : objectCounts[0], soak) ? 0 : 1;
+	}
+
+	std::vector<BenchResult> results;
+
+	if (!positional.empty() && !BenchCapture(positional[0], positional.size() > 1 ? positional[1] : "MapManager", results)) {
+		return 1;
+	}
+
+	for (int32_t objects : objectCounts.empty() ? std::vector<int32_t>{ 100000 } : objectCounts) {
+		for (int32_t actors : actorCounts.empty() ? std::vector<int32_t>{ 100, 10000 } : actorCounts) {
+			if (!BenchFakeGame(actors, objects, results)) {
+				return 1;
+			}
+		}
+	}
+
+	for (size_t count : { 100, 1000, 10000 }) {
+		if (!BenchActorsJson(count, results)) {
+			return 1;
+		}
+	}
+
+	if (!BenchDeflate(results)) {
+		return 1;
+	}
+
+	BenchConfig(results);
+
+	PrintResults(results);
+
+	if (!jsonPath.empty() && !WriteResultsJson(jsonPath, results)) {
+		std::fprintf(stderr, "Unable to write %s\n", jsonPath.c_str());
+		return 1;
+	}
+	return 0;
+}
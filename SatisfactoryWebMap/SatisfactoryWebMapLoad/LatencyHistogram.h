@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Latencies in microseconds, in log-linear buckets: exact below 16us, then 16 buckets per power
+// of two, so every bucket is within about 6% of the values in it. Recording is a few shifts and
+// an increment, one histogram per thread, merged at the end.
+class LatencyHistogram
+{
+public:
+	static constexpr int SubBuckets = 16;
+	static constexpr int BucketCount = (64 - 3) * SubBuckets;
+
+	LatencyHistogram() : counts(BucketCount, 0)
+	{}
+
+	void Record(uint64_t us)
+	{
+		++counts[BucketOf(us)];
+		++total;
+		sum += us;
+		maxValue = (std::max)(maxValue, us);
+	}
+
+	void Merge(const LatencyHistogram &other)
+	{
+		for (int i = 0; i < BucketCount; ++i) {
+			counts[i] += other.counts[i];
+		}
+		total += other.total;
+		sum += other.sum;
+		maxValue = (std::max)(maxValue, other.maxValue);
+	}
+
+	uint64_t Count() const
+	{
+		return total;
+	}
+
+	uint64_t Max() const
+	{
+		return maxValue;
+	}
+
+	double Mean() const
+	{
+		return total ? (double)sum / total : 0.;
+	}
+
+	// Upper bound of the bucket holding the p-th percentile, p in [0, 100]
+	uint64_t Percentile(double p) const
+	{
+		if (total == 0) {
+			return 0;
+		}
+
+		uint64_t rank = (uint64_t)(p / 100. * total + 0.5);
+		rank = (std::min)((std::max)(rank, (uint64_t)1), total);
+
+		uint64_t seen = 0;
+		for (int i = 0; i < BucketCount; ++i) {
+			seen += counts[i];
+			if (seen >= rank) {
+				return (std::min)(LowerBound(i + 1) - 1, maxValue);
+			}
+		}
+		return maxValue;
+	}
+
+	// Non-empty buckets as { lower bound, count }
+	std::vector<std::pair<uint64_t, uint64_t>> Buckets() const
+	{
+		std::vector<std::pair<uint64_t, uint64_t>> buckets;
+		for (int i = 0; i < BucketCount; ++i) {
+			if (counts[i]) {
+				buckets.push_back({ LowerBound(i), counts[i] });
+			}
+		}
+		return buckets;
+	}
+
+	// One row per power of two of milliseconds-ish ranges, with a bar scaled to the largest row
+	void Print(FILE *out, const std::string &title) const
+	{
+		std::fprintf(out, "%s latency, %llu requests\n", title.c_str(), (unsigned long long)total);
+		if (total == 0) {
+			return;
+		}
+
+		// rows of whole powers of two
+		std::vector<uint64_t> rows(64, 0);
+		int first = 63, last = 0;
+		for (int i = 0; i < BucketCount; ++i) {
+			if (counts[i]) {
+				int row = Log2((std::max)(LowerBound(i), (uint64_t)1));
+				rows[row] += counts[i];
+				first = (std::min)(first, row);
+				last = (std::max)(last, row);
+			}
+		}
+
+		uint64_t widest = *std::max_element(rows.begin(), rows.end());
+		for (int row = first; row <= last; ++row) {
+			int width = (int)(rows[row] * 50 / widest);
+			std::fprintf(out, "  %10.3f - %10.3f ms %10llu %s\n", (double)(1ull << row) / 1000., (double)(2ull << row) / 1000.,
+				(unsigned long long)rows[row], std::string(width, '#').c_str());
+		}
+	}
+
+private:
+	static int Log2(uint64_t v)
+	{
+		int e = 0;
+		while (v >> (e + 1)) {
+			++e;
+		}
+		return e;
+	}
+
+	static int BucketOf(uint64_t v)
+	{
+		if (v < SubBuckets) {
+			return (int)v;
+		}
+
+		int e = Log2(v);
+		return (e - 3) * SubBuckets + (int)((v >> (e - 4)) & (SubBuckets - 1));
+	}
+
+	static uint64_t LowerBound(int bucket)
+	{
+		if (bucket < SubBuckets) {
+			return (uint64_t)bucket;
+		}
+
+		int e = bucket / SubBuckets + 3;
+		return (uint64_t)(SubBuckets + bucket % SubBuckets) << (e - 4);
+	}
+
+	std::vector<uint64_t> counts;
+	uint64_t total = 0;
+	uint64_t sum = 0;
+	uint64_t maxValue = 0;
+};
@@ -0,0 +1,497 @@
+#include <httplib.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Config.h"
+#include "Snapshot.h"
+#include "StaticFiles.h"
+#include "MemorySource.h"
+#include "ActorSampler.h"
+#include "ActorsApi.h"
+#include "FakeGame.h"
+#include "LatencyHistogram.h"
+
+// the game globals the sampler reads, pointed into the fake game or the capture
+const TNameEntryArray *Names_0 = nullptr;
+const FUObjectArray *GUObjectArray = nullptr;
+
+using clock_type = std::chrono::steady_clock;
+
+struct LoadOptions
+{
+	std::string Host = "127.0.0.1";
+	int Port = 0;
+
+	int Clients = 32;
+	int Seconds = 30;
+	int PollMs = 1000;
+	int AssetsMs = 0;
+	int RevalidatePercent = 50;
+	bool KeepAlive = true;
+
+	// the stand-in server
+	int Actors = 10000;
+	std::string Capture;
+	std::string ConfigFile = "config.json";
+
+	std::string JsonFile;
+};
+
+// What a page load fetches from the server: index.html and the local files it refers to, the
+// rest comes from CDNs. Filled by FindPageAssets from the served index.html.
+std::vector<std::string> PageAssets = { "/" };
+
+// Adds the src and href of index.html that point at the server itself
+void FindPageAssets(const std::string &html)
+{
+	static const std::regex reference(R"re((?:src|href)="([^"#]+)")re");
+
+	for (std::sregex_iterator it(html.begin(), html.end(), reference), end; it != end; ++it) {
+		auto path = (*it)[1].str();
+		if (path.find("://") != std::string::npos || path.compare(0, 2, "//") == 0 || path.compare(0, 5, "data:") == 0) {
+			continue;
+		}
+
+		if (path[0] != '/') {
+			path = "/" + path;
+		}
+		if (std::find(PageAssets.begin(), PageAssets.end(), path) == PageAssets.end()) {
+			PageAssets.push_back(path);
+		}
+	}
+}
+
+struct RequestStats
+{
+	LatencyHistogram Latency;
+	uint64_t Requests = 0;
+	uint64_t Bytes = 0;
+	uint64_t Ok = 0;
+	uint64_t NotModified = 0;
+	uint64_t OtherStatus = 0;
+	uint64_t Failed = 0; // no response at all
+
+	void Merge(const RequestStats &other)
+	{
+		Latency.Merge(other.Latency);
+		Requests += other.Requests;
+		Bytes += other.Bytes;
+		Ok += other.Ok;
+		NotModified += other.NotModified;
+		OtherStatus += other.OtherStatus;
+		Failed += other.Failed;
+	}
+};
+
+struct ClientStats
+{
+	RequestStats Actors;
+	RequestStats Assets;
+};
+
+// The /api/actors side of the DLL on a fake game or a capture: the same snapshot thread, sampler
+// scheduler, filters, serializer, ETags, compressed variants, static files and thread pool size,
+// only the memory it samples is different.
+class StandInServer
+{
+public:
+	bool Start(const LoadOptions &options)
+	{
+		config = Config::Load(options.ConfigFile);
+
+		if (!options.Capture.empty()) {
+			if (!dump.Load(options.Capture)) {
+				std::fprintf(stderr, "Unable to load %s\n", options.Capture.c_str());
+				return false;
+			}
+
+			Names_0 = dump.Root<TNameEntryArray>("names");
+			GUObjectArray = dump.Root<FUObjectArray>("objects");
+			mapManager = dump.Root<FGMapManager>("mapmanager");
+			memory = &dump;
+		} else {
+			FakeGame::Options fake;
+			fake.Actors = options.Actors;
+			fake.MapManagerName = config.MapManagerName;
+
+			game = std::make_unique<FakeGame>(fake);
+			game->Install();
+			mapManager = game->MapManager();
+			memory = &processMemory;
+		}
+
+		if (config.IdleSampleMs > 0) {
+			scheduler = std::make_unique<ActorScheduler>(std::chrono::milliseconds(config.IdleSampleMs));
+		}
+
+		snapshots.Start([this](std::vector<ActorState> &actors, std::string &error) {
+			if (game) {
+				game->Step(config.SnapshotInterval / 1000.f);
+			}
+			if (scheduler) {
+				return scheduler->Sample(*memory, mapManager, actors, error);
+			}
+			return ReadActors(*memory, mapManager, actors, error);
+		}, SerializeActors, config.SnapshotInterval, config.DeltaHistory);
+
+		server.new_task_queue = [this] {
+			return new httplib::ThreadPool((std::max)(config.Threads, config.MaxStreams + 4));
+		};
+
+		server.Get("/api/actors", [this](const httplib::Request &req, httplib::Response &res) {
+			ActorSubscription filter;
+			auto error = filter.ParseQuery(req);
+			if (!error.empty()) {
+				res.set_content(nlohmann::json({ { "status", "err" }, { "msg", error } }).dump(), "application/json");
+				return;
+			}
+
+			auto snapshot = snapshots.Latest();
+			if (!snapshot) {
+				res.set_content(R"({"status": "err", "msg": "invalid obj"})", "application/json");
+				return;
+			}
+
+			SendActors(req, res, snapshot, filter, config.CompressionLevel);
+		});
+
+		auto root = config.Root.empty() ? std::string("web") : config.Root;
+		if (!staticFiles.Load(root, config.CompressionLevel)) {
+			std::fprintf(stderr, "No web root at %s, static files will be 404\n", root.c_str());
+		}
+
+		server.Get(".*", [this](const httplib::Request &req, httplib::Response &res) {
+			if (!staticFiles.Serve(req, res)) {
+				res.status = 404;
+			}
+		});
+
+		if (!server.bind_to_port(config.IP.c_str(), config.Port)) {
+			std::fprintf(stderr, "Unable to listen on %s:%d\n", config.IP.c_str(), config.Port);
+			return false;
+		}
+
+		listener = std::thread([this] { server.listen_after_bind(); });
+
+		// the first snapshot, so the first requests do not measure the sampler
+		snapshots.WaitNewer(0, std::chrono::seconds(10));
+		return true;
+	}
+
+	void Stop()
+	{
+		server.stop();
+		if (listener.joinable()) {
+			listener.join();
+		}
+		snapshots.Stop();
+	}
+
+	int Port() const
+	{
+		return config.Port;
+	}
+
+	std::string Description() const
+	{
+		if (game) {
+			return "fake game with " + std::to_string(game->ObjectCount()) + " objects";
+		}
+		return "capture";
+	}
+
+private:
+	Config config;
+
+	MemoryDump dump;
+	ProcessMemory processMemory;
+	std::unique_ptr<FakeGame> game;
+	const MemorySource *memory = nullptr;
+	const FGMapManager *mapManager = nullptr;
+	std::unique_ptr<ActorScheduler> scheduler;
+
+	SnapshotEngine snapshots;
+	StaticFiles staticFiles;
+	httplib::Server server;
+	std::thread listener;
+};
+
+void Fetch(httplib::Client &client, const std::string &path, const httplib::Headers &headers,
+	clock_type::time_point since, RequestStats &stats, std::string *etag = nullptr)
+{
+	auto res = client.Get(path.c_str(), headers);
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - since);
+
+	++stats.Requests;
+	stats.Latency.Record((uint64_t)elapsed.count());
+
+	if (!res) {
+		++stats.Failed;
+		return;
+	}
+
+	stats.Bytes += res->body.size();
+	if (res->status == 200) {
+		++stats.Ok;
+		if (etag) {
+			*etag = res->get_header_value("ETag");
+		}
+	} else if (res->status == 304) {
+		++stats.NotModified;
+	} else {
+		++stats.OtherStatus;
+	}
+}
+
+// One browser tab: loads the page, then polls /api/actors like the realtime layer does, with the
+// ETag of the last answer and gzip accepted. Polls are timed from when they were due, so a slow
+// server shows up as latency instead of as fewer requests. Page reloads are revalidations with
+// the ETags of the last load (a browser's reload) or cold loads, mixed by --revalidate.
+void RunClient(int id, const LoadOptions &options, clock_type::time_point start, clock_type::time_point end, ClientStats &stats)
+{
+	httplib::Client client(options.Host, options.Port);
+	client.set_keep_alive(options.KeepAlive);
+	client.set_decompress(false);
+	client.set_connection_timeout(5);
+	client.set_read_timeout(30);
+
+	// tabs are not opened in the same millisecond
+	std::mt19937 rng(id);
+	auto poll = std::chrono::milliseconds((std::max)(options.PollMs, 1));
+	auto nextPoll = start + std::chrono::milliseconds(std::uniform_int_distribution<int>(0, (int)poll.count() - 1)(rng));
+	auto nextAssets = nextPoll;
+
+	std::bernoulli_distribution revalidate(options.RevalidatePercent / 100.);
+	std::vector<std::string> assetTags(PageAssets.size());
+	bool loaded = false;
+	std::string etag;
+
+	while (true) {
+		bool assets = nextAssets <= nextPoll;
+		auto due = assets ? nextAssets : nextPoll;
+		if (due >= end) {
+			break;
+		}
+		std::this_thread::sleep_until(due);
+
+		if (assets) {
+			bool warm = loaded && revalidate(rng);
+			for (size_t i = 0; i < PageAssets.size(); ++i) {
+				httplib::Headers headers{ { "Accept-Encoding", "gzip, deflate" } };
+				if (warm && !assetTags[i].empty()) {
+					headers.emplace("If-None-Match", assetTags[i]);
+				}
+				Fetch(client, PageAssets[i], headers, clock_type::now(), stats.Assets, &assetTags[i]);
+			}
+			loaded = true;
+
+			nextAssets = options.AssetsMs > 0 ? due + std::chrono::milliseconds(options.AssetsMs) : (clock_type::time_point::max)();
+			nextPoll = (std::max)(nextPoll, clock_type::now());
+			continue;
+		}
+
+		httplib::Headers headers{ { "Accept-Encoding", "gzip, deflate" } };
+		if (!etag.empty()) {
+			headers.emplace("If-None-Match", etag);
+		}
+		Fetch(client, "/api/actors", headers, due, stats.Actors, &etag);
+
+		nextPoll += poll;
+	}
+}
+
+void PrintSummary(const char *name, const RequestStats &stats, double seconds)
+{
+	const auto &h = stats.Latency;
+	std::printf("%-8s %9llu %9.1f %9.2f %7llu %7llu %7llu %7llu %9.2f %9.2f %9.2f %9.2f %9.2f\n", name,
+		(unsigned long long)stats.Requests, stats.Requests / seconds, stats.Bytes / seconds / 1e6,
+		(unsigned long long)stats.Ok, (unsigned long long)stats.NotModified, (unsigned long long)stats.OtherStatus,
+		(unsigned long long)stats.Failed, h.Percentile(50) / 1000., h.Percentile(90) / 1000., h.Percentile(99) / 1000.,
+		h.Percentile(99.9) / 1000., h.Max() / 1000.);
+}
+
+nlohmann::json StatsToJson(const RequestStats &stats, double seconds)
+{
+	const auto &h = stats.Latency;
+
+	auto buckets = nlohmann::json::array();
+	for (const auto &bucket : h.Buckets()) {
+		buckets.push_back({ bucket.first, bucket.second });
+	}
+
+	return {
+		{ "requests", stats.Requests },
+		{ "requests_per_sec", stats.Requests / seconds },
+		{ "bytes", stats.Bytes },
+		{ "ok", stats.Ok },
+		{ "not_modified", stats.NotModified },
+		{ "other_status", stats.OtherStatus },
+		{ "failed", stats.Failed },
+		{ "latency_us", {
+			{ "mean", h.Mean() },
+			{ "p50", h.Percentile(50) },
+			{ "p90", h.Percentile(90) },
+			{ "p99", h.Percentile(99) },
+			{ "p999", h.Percentile(99.9) },
+			{ "max", h.Max() },
+			{ "buckets", buckets },
+		} },
+	};
+}
+
+// SatisfactoryWebMapLoad [options]
+//   --url <host:port>        server to load, without it a stand-in server samples a fake game
+//   --clients <n>            simulated browser tabs, 32 by default
+//   --duration <seconds>     30 by default
+//   --poll <ms>              /api/actors interval of every tab, 1000 by default
+//   --assets <ms>            reload the page this often, 0 (default) loads it once per tab
+//   --revalidate <percent>   reloads sent with the ETags of the last load, 50 by default
+//   --keep-alive on|off      reuse connections, on by default
+//   --actors <n>             size of the stand-in server's fake game, 10000 by default
+//   --capture <file>         the stand-in server replays a capture instead
+//   --config <file>          config.json of the stand-in server (port, threads, root, compression)
+//   --json <file>            also write the report as JSON
+int main(int argc, char **argv)
+{
+	LoadOptions options;
+	std::string url;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (i + 1 >= argc || arg.compare(0, 2, "--") != 0) {
+			std::fprintf(stderr, "Bad argument %s\n", arg.c_str());
+			return 1;
+		}
+
+		std::string value = argv[++i];
+		if (arg == "--url") {
+			url = value;
+		} else if (arg == "--clients") {
+			options.Clients = std::atoi(value.c_str());
+		} else if (arg == "--duration") {
+			options.Seconds = std::atoi(value.c_str());
+		} else if (arg == "--poll") {
+			options.PollMs = std::atoi(value.c_str());
+		} else if (arg == "--assets") {
+			options.AssetsMs = std::atoi(value.c_str());
+		} else if (arg == "--revalidate") {
+			options.RevalidatePercent = (std::min)((std::max)(std::atoi(value.c_str()), 0), 100);
+		} else if (arg == "--keep-alive") {
+			options.KeepAlive = value != "off";
+		} else if (arg == "--actors") {
+			options.Actors = std::atoi(value.c_str());
+		} else if (arg == "--capture") {
+			options.Capture = value;
+		} else if (arg == "--config") {
+			options.ConfigFile = value;
+		} else if (arg == "--json") {
+			options.JsonFile = value;
+		} else {
+			std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+			return 1;
+		}
+	}
+
+	StandInServer standIn;
+	std::string target;
+
+	if (url.empty()) {
+		if (!standIn.Start(options)) {
+			return 1;
+		}
+		options.Port = standIn.Port();
+		target = standIn.Description();
+	} else {
+		if (url.compare(0, 7, "http://") == 0) {
+			url = url.substr(7);
+		}
+
+		auto colon = url.rfind(':');
+		options.Host = url.substr(0, colon);
+		options.Port = colon == std::string::npos ? 80 : std::atoi(url.c_str() + colon + 1);
+		target = url;
+	}
+
+	// the page as this server serves it, uncompressed
+	{
+		httplib::Client client(options.Host, options.Port);
+		client.set_connection_timeout(5);
+		auto res = client.Get("/");
+		if (res && res->status == 200) {
+			FindPageAssets(res->body);
+		} else {
+			std::fprintf(stderr, "No index.html at %s, page loads only fetch /\n", target.c_str());
+		}
+	}
+
+	std::printf("%d clients for %d s against %s, poll %d ms, keep-alive %s\n", options.Clients, options.Seconds,
+		target.c_str(), options.PollMs, options.KeepAlive ? "on" : "off");
+	std::printf("page of %zu files, %d%% of reloads revalidated\n", PageAssets.size(), options.RevalidatePercent);
+
+	std::vector<ClientStats> stats(options.Clients);
+	std::vector<std::thread> clients;
+
+	auto start = clock_type::now();
+	auto end = start + std::chrono::seconds(options.Seconds);
+	for (int i = 0; i < options.Clients; ++i) {
+		clients.emplace_back(RunClient, i, std::cref(options), start, end, std::ref(stats[i]));
+	}
+	for (auto &client : clients) {
+		client.join();
+	}
+
+	double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+	if (url.empty()) {
+		standIn.Stop();
+	}
+
+	ClientStats total;
+	for (const auto &client : stats) {
+		total.Actors.Merge(client.Actors);
+		total.Assets.Merge(client.Assets);
+	}
+
+	std::printf("\n%-8s %9s %9s %9s %7s %7s %7s %7s %9s %9s %9s %9s %9s\n", "", "requests", "req/s", "MB/s",
+		"200", "304", "other", "failed", "p50 ms", "p90 ms", "p99 ms", "p999 ms", "max ms");
+	PrintSummary("actors", total.Actors, seconds);
+	PrintSummary("assets", total.Assets, seconds);
+
+	std::printf("\n");
+	total.Actors.Latency.Print(stdout, "/api/actors");
+	total.Assets.Latency.Print(stdout, "static files");
+
+	if (!options.JsonFile.empty()) {
+		nlohmann::json report = {
+			{ "target", target },
+			{ "clients", options.Clients },
+			{ "seconds", seconds },
+			{ "poll_ms", options.PollMs },
+			{ "assets_ms", options.AssetsMs },
+			{ "revalidate_percent", options.RevalidatePercent },
+			{ "page_assets", PageAssets },
+			{ "keep_alive", options.KeepAlive },
+			{ "actors", StatsToJson(total.Actors, seconds) },
+			{ "assets", StatsToJson(total.Assets, seconds) },
+		};
+
+		std::ofstream out(options.JsonFile);
+		out << std::setw(4) << report << std::endl;
+		if (!out) {
+			std::fprintf(stderr, "Unable to write %s\n", options.JsonFile.c_str());
+			return 1;
+		}
+	}
+
+	return total.Actors.Failed + total.Assets.Failed == 0 ? 0 : 2;
+}
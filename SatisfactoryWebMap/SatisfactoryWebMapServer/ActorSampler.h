@@ -0,0 +1,373 @@
+#pragma once
+
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "FactoryGameSDK.h"
+#include "MemorySource.h"
+#include "Snapshot.h"
+
+// Representation manager of a map manager, nullptr when it has none (yet)
+inline const FGActorRepresentationManager *RepresentationManager(const MemorySource &memory, const FGMapManager *mapManager)
+{
+	if (mapManager == nullptr) {
+		return nullptr;
+	}
+	return memory.Get(&mapManager->mActorRepresentationManager);
+}
+
+// Pointers in the replicated representation array of mapManager, nulls left out
+inline bool ReadRepresentationPointers(const MemorySource &memory, const FGMapManager *mapManager, std::vector<const FGActorRepresentation *> &pointers,
+	std::string &error)
+{
+	auto respMgr = RepresentationManager(memory, mapManager);
+
+	TArray<FGActorRepresentation *> array{};
+	if (respMgr == nullptr || !memory.Read(&respMgr->mReplicatedRepresentations, array)) {
+		error = "invalid obj";
+		return false;
+	}
+
+	pointers.resize(array.ArrayNum > 0 ? array.ArrayNum : 0);
+	if (!pointers.empty() && !memory.Read(array.Data, pointers.data(), pointers.size() * sizeof(FGActorRepresentation *))) {
+		error = "invalid obj";
+		return false;
+	}
+
+	pointers.erase(std::remove(pointers.begin(), pointers.end(), nullptr), pointers.end());
+	return true;
+}
+
+// Copies the representations at pointers into states, one each.
+// Reads level by level in batches: the representations, their actors' root components, then
+// the component transforms.
+inline void ReadRepresentations(const MemorySource &memory, const FGActorRepresentation *const *pointers, size_t size, ActorState *states)
+{
+	// scratch space of the snapshot thread, kept between samples
+	thread_local std::vector<FGActorRepresentation> reps;
+	thread_local std::vector<USceneComponent *> roots;
+	thread_local std::vector<FTransform> transforms;
+	thread_local std::vector<Vector3> velocities;
+	thread_local std::vector<MemorySource::Range> ranges;
+
+	reps.resize(size);
+	roots.assign(size, nullptr);
+	transforms.resize(size);
+	velocities.resize(size);
+
+	ranges.clear();
+	for (size_t i = 0; i < size; ++i) {
+		ranges.push_back({ pointers[i], &reps[i], sizeof(FGActorRepresentation) });
+	}
+	memory.ReadBatch(ranges.data(), ranges.size());
+
+	ranges.clear();
+	for (size_t i = 0; i < size; ++i) {
+		if (reps[i].mRealActor != nullptr) {
+			ranges.push_back({ &reps[i].mRealActor->RootComponent, &roots[i], sizeof(USceneComponent *) });
+		}
+	}
+	memory.ReadBatch(ranges.data(), ranges.size());
+
+	ranges.clear();
+	for (size_t i = 0; i < size; ++i) {
+		if (roots[i] != nullptr) {
+			ranges.push_back({ &roots[i]->ComponentToWorld, &transforms[i], sizeof(FTransform) });
+			ranges.push_back({ &roots[i]->ComponentVelocity, &velocities[i], sizeof(Vector3) });
+		}
+	}
+	memory.ReadBatch(ranges.data(), ranges.size());
+
+	for (size_t i = 0; i < size; ++i) {
+		const auto &actorResp = reps[i];
+
+		ActorState state{};
+		state.Index = actorResp.InternalIndex;
+		state.Type = actorResp.mRepresentationType;
+		state.IsStatic = actorResp.mIsStatic;
+		state.Color[0] = actorResp.mRepresentationColor.R;
+		state.Color[1] = actorResp.mRepresentationColor.G;
+		state.Color[2] = actorResp.mRepresentationColor.B;
+		state.Color[3] = actorResp.mRepresentationColor.A;
+
+		if (actorResp.mRealActor == nullptr || roots[i] == nullptr) {
+			const auto &loc = actorResp.mActorLocation;
+			const auto &rot = actorResp.mActorRotation;
+
+			state.Location[0] = loc.x; state.Location[1] = loc.y; state.Location[2] = loc.z;
+			state.Rotation[0] = rot.pitch; state.Rotation[1] = rot.yaw; state.Rotation[2] = rot.roll;
+		} else {
+			const auto &loc = transforms[i].Translation;
+			const auto &rot = transforms[i].Rotation;
+			const auto &vel = velocities[i];
+
+			state.Location[0] = loc.x; state.Location[1] = loc.y; state.Location[2] = loc.z;
+			state.Rotation[0] = rot.x; state.Rotation[1] = rot.y; state.Rotation[2] = rot.z;
+			state.Velocity[0] = vel.x; state.Velocity[1] = vel.y; state.Velocity[2] = vel.z;
+			state.HasVelocity = true;
+		}
+
+		states[i] = state;
+	}
+}
+
+// Copies every replicated actor representation of mapManager into actors
+inline bool ReadActors(const MemorySource &memory, const FGMapManager *mapManager, std::vector<ActorState> &actors, std::string &error)
+{
+	thread_local std::vector<const FGActorRepresentation *> pointers;
+	if (!ReadRepresentationPointers(memory, mapManager, pointers, error)) {
+		return false;
+	}
+
+	const size_t offset = actors.size();
+	actors.resize(offset + pointers.size());
+	ReadRepresentations(memory, pointers.data(), pointers.size(), actors.data() + offset);
+	return true;
+}
+
+// Serial number of the GUObjectArray slot index while it holds object, -1 when it holds
+// something else or cannot be read
+inline int32_t ObjectSerial(const MemorySource &memory, const FChunkedFixedUObjectArray &objects, int32_t index, const void *object)
+{
+	constexpr int32_t PerChunk = FChunkedFixedUObjectArray::NumElementsPerChunk;
+	if (index < 0 || index >= objects.NumElements) {
+		return -1;
+	}
+
+	auto chunk = memory.Get(objects.Objects + index / PerChunk);
+	FUObjectItem item;
+	if (chunk == nullptr || !memory.Read(chunk + index % PerChunk, item) || item.Object != object) {
+		return -1;
+	}
+	return item.SerialNumber;
+}
+
+// ReadActors() that only reads what may have changed. The pointer array is read every time, so
+// added and removed representations show up at once; of the rest:
+//
+// - static representations are read once, then only when the GUObjectArray serial of their slot
+//   changes, which is checked for a slice of them every time, all of them every StaticCheck
+// - everything else is read again when it may have moved Tolerance at the speed it had, from
+//   ComponentVelocity or how far it went since the last read, an idle actor after idle
+// - players, trains and vehicles every time, moving or not
+//
+// Every actor is still returned, the ones not read as they were. One instance per snapshot thread.
+class ActorScheduler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr float Tolerance = 100.f; // cm
+	static constexpr std::chrono::milliseconds StaticCheck{ 5000 };
+
+	// of the last Sample()
+	struct Stats
+	{
+		size_t Actors;
+		size_t Static;
+		size_t Read;
+	};
+
+	explicit ActorScheduler(std::chrono::milliseconds idle) : idle(idle)
+	{}
+
+	bool Sample(const MemorySource &memory, const FGMapManager *mapManager, std::vector<ActorState> &actors, std::string &error)
+	{
+		return Sample(memory, mapManager, Clock::now(), actors, error);
+	}
+
+	bool Sample(const MemorySource &memory, const FGMapManager *mapManager, Clock::time_point now, std::vector<ActorState> &actors,
+		std::string &error)
+	{
+		if (!ReadRepresentationPointers(memory, mapManager, current, error)) {
+			return false;
+		}
+
+		if (current != pointers) {
+			Realign();
+		}
+
+		CheckSerials(memory, now);
+
+		due.clear();
+		duePointers.clear();
+		for (size_t i = 0; i < entries.size(); ++i) {
+			if (!entries[i].Known || entries[i].Due <= now) {
+				due.push_back(i);
+				duePointers.push_back(pointers[i]);
+			}
+		}
+
+		fresh.resize(due.size());
+		ReadRepresentations(memory, duePointers.data(), duePointers.size(), fresh.data());
+
+		FChunkedFixedUObjectArray objects{};
+		bool haveObjects = GUObjectArray != nullptr && memory.Read(&GUObjectArray->ObjObjects, objects);
+
+		for (size_t k = 0; k < due.size(); ++k) {
+			auto &entry = entries[due[k]];
+			const auto &state = fresh[k];
+
+			if (!entry.Known || entry.State.Index != state.Index) {
+				entry.Serial = haveObjects ? ObjectSerial(memory, objects, state.Index, pointers[due[k]]) : -1;
+			}
+			Schedule(entry, state, now);
+		}
+
+		stats = { entries.size(), 0, due.size() };
+		actors.reserve(actors.size() + entries.size());
+		for (const auto &entry : entries) {
+			stats.Static += entry.State.IsStatic;
+			actors.push_back(entry.State);
+		}
+
+		return true;
+	}
+
+	const Stats &LastStats() const
+	{
+		return stats;
+	}
+
+private:
+	struct Entry
+	{
+		ActorState State{};
+		bool Known = false;
+		int32_t Serial = -1;
+		Clock::time_point Read;
+		Clock::time_point Due;
+	};
+
+	// entries follow the pointer array, the ones of pointers still in it are kept
+	void Realign()
+	{
+		std::unordered_map<const FGActorRepresentation *, std::pair<size_t, Entry>> old;
+		old.reserve(pointers.size());
+		for (size_t i = 0; i < pointers.size(); ++i) {
+			old.emplace(pointers[i], std::make_pair(i, entries[i]));
+		}
+
+		pointers = current;
+		entries.assign(pointers.size(), Entry{});
+		recheck.clear();
+		for (size_t i = 0; i < pointers.size(); ++i) {
+			auto it = old.find(pointers[i]);
+			if (it != old.end()) {
+				entries[i] = it->second.second;
+				if (it->second.first != i) {
+					recheck.push_back(i);
+				}
+				old.erase(it);
+			}
+		}
+
+		// the array changes all the time while building, the sweep has to go on where it was
+		nextCheck = entries.empty() ? 0 : nextCheck % entries.size();
+	}
+
+	// a slot reused by the garbage collector reads the representation again
+	void CheckSerials(const MemorySource &memory, Clock::time_point now)
+	{
+		if (entries.empty() || GUObjectArray == nullptr) {
+			lastCheck = now;
+			recheck.clear();
+			return;
+		}
+
+		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastCheck).count();
+		auto count = (std::min)(entries.size(), (size_t)(elapsed > 0 ? elapsed : 0) * entries.size() / (size_t)StaticCheck.count() + 1);
+		lastCheck = now;
+
+		FChunkedFixedUObjectArray objects{};
+		if (!memory.Read(&GUObjectArray->ObjObjects, objects)) {
+			return;
+		}
+
+		auto verify = [&](size_t i) {
+			auto &entry = entries[i];
+			if (entry.Known && entry.State.IsStatic && ObjectSerial(memory, objects, entry.State.Index, pointers[i]) != entry.Serial) {
+				entry.Known = false;
+			}
+		};
+
+		// entries that moved in the array, a pointer seen again may be a new representation
+		for (auto i : recheck) {
+			verify(i);
+		}
+		recheck.clear();
+
+		for (size_t n = 0; n < count; ++n, nextCheck = (nextCheck + 1) % entries.size()) {
+			verify(nextCheck);
+		}
+	}
+
+	void Schedule(Entry &entry, const ActorState &state, Clock::time_point now)
+	{
+		double speed = 0;
+		if (state.HasVelocity) {
+			speed = std::sqrt((double)state.Velocity[0] * state.Velocity[0] + (double)state.Velocity[1] * state.Velocity[1] +
+				(double)state.Velocity[2] * state.Velocity[2]);
+		}
+
+		// representations without a real actor only tell by moving
+		auto seconds = std::chrono::duration<double>(now - entry.Read).count();
+		if (entry.Known && seconds > 0) {
+			double dx = state.Location[0] - entry.State.Location[0];
+			double dy = state.Location[1] - entry.State.Location[1];
+			double dz = state.Location[2] - entry.State.Location[2];
+			speed = (std::max)(speed, std::sqrt(dx * dx + dy * dy + dz * dz) / seconds);
+		}
+
+		entry.State = state;
+		entry.Known = true;
+		entry.Read = now;
+
+		if (state.IsStatic) {
+			entry.Due = Clock::time_point::max();
+			return;
+		}
+
+		// standing still now says nothing about the next second
+		if (FastMover(state.Type)) {
+			entry.Due = now;
+			return;
+		}
+
+		std::chrono::duration<double> wait = idle;
+		if (!std::isfinite(speed)) {
+			wait = wait.zero();
+		} else if (speed > 0) {
+			wait = (std::min)(wait, std::chrono::duration<double>(Tolerance / speed));
+		}
+		entry.Due = now + std::chrono::duration_cast<Clock::duration>(wait);
+	}
+
+	// players, trains and vehicles, read every time even when they stand still
+	static bool FastMover(int8_t type)
+	{
+		return type == RT_Player || type == RT_Train || type == RT_Vehicle;
+	}
+
+	std::chrono::milliseconds idle;
+
+	std::vector<const FGActorRepresentation *> pointers; // as of the last Sample()
+	std::vector<Entry> entries;                           // one per pointer
+
+	size_t nextCheck = 0;
+	std::vector<size_t> recheck; // moved by the last Realign()
+	Clock::time_point lastCheck;
+
+	// scratch space kept between samples
+	std::vector<const FGActorRepresentation *> current;
+	std::vector<size_t> due;
+	std::vector<const FGActorRepresentation *> duePointers;
+	std::vector<ActorState> fresh;
+
+	Stats stats{};
+};
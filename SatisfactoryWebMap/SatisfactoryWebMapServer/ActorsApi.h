@@ -0,0 +1,343 @@
+#pragma once
+
+#include <httplib.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "Snapshot.h"
+#include "Hash.h"
+#include "HttpHelpers.h"
+#include "GeoJsonWriter.h"
+#include "ActorsBinary.h"
+
+// The /api/actors side of the server: bodies, filters and the responses with their ETags and
+// compressed copies. Shared by the dll and the load tool, so the load numbers are the dll's.
+
+// GeoJSON body of /api/actors
+inline std::string SerializeActors(const Snapshot &snapshot)
+{
+	// reused between versions, only the returned copy is allocated
+	thread_local std::string buffer;
+	buffer.clear();
+
+	GeoJsonWriter(buffer).FeatureCollection(snapshot);
+	return buffer;
+}
+
+// Body of /api/actors.bin, see ActorsBinary.h
+inline std::string SerializeActorsBinary(const Snapshot &snapshot)
+{
+	ActorsBinaryWriter writer(snapshot.Actors.size());
+
+	for (const auto &actor : snapshot.Actors) {
+		writer.Add(actor.Index, (uint8_t)actor.Type, actor.Location, actor.Rotation,
+			actor.HasVelocity ? actor.Velocity : nullptr, actor.Color);
+	}
+
+	return writer.Finish(snapshot.Seq, snapshot.Time, snapshot.Valid, snapshot.Error);
+}
+
+// What a WebSocket client asked for, changed by subscribe and viewport messages
+struct ActorSubscription
+{
+	std::vector<int> Types; // empty means every type
+
+	bool HasBounds = false;
+	float Bounds[4]; // minX, minY, maxX, maxY in world units
+
+	int Rate = 1000; // minimum ms between two updates
+	bool Binary = false; // MessagePack frames instead of JSON text
+
+	bool Matches(const ActorState &actor) const
+	{
+		if (!Types.empty() && std::find(Types.begin(), Types.end(), actor.Type) == Types.end()) {
+			return false;
+		}
+
+		if (HasBounds) {
+			const auto &loc = actor.Location;
+			if (loc[0] < Bounds[0] || loc[1] < Bounds[1] || loc[0] > Bounds[2] || loc[1] > Bounds[3]) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Bit per type for SpatialGrid::Query, AllTypes when a type has no bit (outside 0-63)
+	// and Select has to check every actor the grid returns
+	uint64_t TypeMask() const
+	{
+		uint64_t mask = 0;
+		for (auto type : Types) {
+			if (type < 0 || type >= 64) {
+				return SpatialGrid::AllTypes;
+			}
+			mask |= 1ull << type;
+		}
+		return Types.empty() ? SpatialGrid::AllTypes : mask;
+	}
+
+	bool IsFiltered() const
+	{
+		return HasBounds || !Types.empty();
+	}
+
+	// Matching actors of snapshot in Index order, from its grid when there is a bounding box
+	void Select(const Snapshot &snapshot, std::vector<const ActorState *> &out) const
+	{
+		if (HasBounds) {
+			auto mask = TypeMask();
+			snapshot.Grid.Query(snapshot.Actors, Bounds, mask, out);
+			if (mask == SpatialGrid::AllTypes && !Types.empty()) {
+				out.erase(std::remove_if(out.begin(), out.end(), [&](const ActorState *actor) {
+					return !Matches(*actor);
+				}), out.end());
+			}
+			return;
+		}
+
+		out.clear();
+		for (const auto &actor : snapshot.Actors) {
+			if (Matches(actor)) {
+				out.push_back(&actor);
+			}
+		}
+	}
+
+	// [minX, minY, maxX, maxY], bounds is left alone unless it is valid
+	static bool ParseBounds(const nlohmann::json &j, float bounds[4])
+	{
+		if (!j.is_array() || j.size() != 4) {
+			return false;
+		}
+
+		float parsed[4];
+		for (int i = 0; i < 4; ++i) {
+			if (!j[i].is_number()) {
+				return false;
+			}
+			parsed[i] = j[i].get<float>();
+		}
+		if (!(parsed[0] <= parsed[2] && parsed[1] <= parsed[3])) {
+			return false;
+		}
+
+		std::copy(parsed, parsed + 4, bounds);
+		return true;
+	}
+
+	// Comma separated numbers, false when text has anything else
+	static bool ParseList(const std::string &text, std::vector<double> &values)
+	{
+		values.clear();
+
+		const char *p = text.c_str();
+		while (true) {
+			char *end = nullptr;
+			double v = std::strtod(p, &end);
+			if (end == p || !std::isfinite(v)) {
+				return false;
+			}
+			values.push_back(v);
+
+			if (*end == '\0') {
+				return true;
+			}
+			if (*end != ',') {
+				return false;
+			}
+			p = end + 1;
+		}
+	}
+
+	// bbox=minX,minY,maxX,maxY and types=5,12 query parameters of /api/actors and the stream,
+	// returns an error message or an empty string
+	std::string ParseQuery(const httplib::Request &req)
+	{
+		std::vector<double> values;
+
+		if (req.has_param("bbox")) {
+			if (!ParseList(req.get_param_value("bbox"), values) || values.size() != 4) {
+				return "invalid bbox";
+			}
+
+			for (int i = 0; i < 4; ++i) {
+				Bounds[i] = (float)values[i];
+			}
+			if (Bounds[0] > Bounds[2] || Bounds[1] > Bounds[3]) {
+				return "invalid bbox";
+			}
+			HasBounds = true;
+		}
+
+		if (req.has_param("types")) {
+			if (!ParseList(req.get_param_value("types"), values)) {
+				return "invalid types";
+			}
+
+			Types.clear();
+			for (auto v : values) {
+				if (v < 0 || v > 127 || v != std::floor(v)) {
+					return "invalid types";
+				}
+				Types.push_back((int)v);
+			}
+		}
+
+		return "";
+	}
+
+	// Applies one client message, returns an error message or an empty string. A message with
+	// an error changes nothing, a value of the wrong type throws and changes nothing either.
+	std::string Update(const nlohmann::json &msg, bool &resync)
+	{
+		ActorSubscription next = *this;
+		auto error = next.Apply(msg, resync);
+		if (error.empty()) {
+			*this = next;
+		}
+		return error;
+	}
+
+private:
+	std::string Apply(const nlohmann::json &msg, bool &resync)
+	{
+		auto op = msg.value("op", "");
+
+		if (op == "subscribe") {
+			if (msg.contains("types")) {
+				Types = msg["types"].is_null() ? std::vector<int>() : msg["types"].get<std::vector<int>>();
+			}
+
+			if (msg.contains("rate")) {
+				Rate = (std::max)(msg["rate"].get<int>(), 50);
+			}
+
+			if (msg.contains("format")) {
+				auto format = msg["format"].get<std::string>();
+				if (format != "json" && format != "msgpack") {
+					return "unknown format";
+				}
+				Binary = format == "msgpack";
+			}
+		} else if (op == "resync") {
+			resync = true;
+			return "";
+		} else if (op != "viewport") {
+			return "unknown op";
+		}
+
+		// subscribe and viewport both carry a bounding box, null clears it
+		if (msg.contains("bbox")) {
+			if (msg["bbox"].is_null()) {
+				HasBounds = false;
+			} else if (ParseBounds(msg["bbox"], Bounds)) {
+				HasBounds = true;
+			} else {
+				return "invalid bbox";
+			}
+		}
+
+		return "";
+	}
+};
+
+// Sends the json or bin body of a snapshot. Compressed copies are made by the first
+// request that asks for one and shared by everyone else until the next version.
+inline void SendSnapshot(const httplib::Request &req, httplib::Response &res, const SnapshotPtr &snapshot,
+	const std::string &format, const char *contentType, int compressionLevel)
+{
+	auto body = format == "bin" ? snapshot->Variant("bin", SerializeActorsBinary)
+		: std::shared_ptr<const std::string>(snapshot, &snapshot->Body);
+
+	std::string encoding;
+	if (compressionLevel > 0 && body->size() >= 256) {
+		encoding = AcceptedEncoding(req);
+	}
+
+	auto etag = snapshot->ETag.substr(0, snapshot->ETag.size() - 1);
+	if (format == "bin") {
+		etag += "-bin";
+	}
+	if (!encoding.empty()) {
+		etag += "-" + encoding;
+	}
+	etag += "\"";
+
+	res.set_header("Cache-Control", "no-cache");
+	res.set_header("Vary", "Accept-Encoding");
+	if (NotModified(req, res, etag)) {
+		return;
+	}
+
+	if (!encoding.empty()) {
+		body = snapshot->Variant(format + "." + encoding, [&](const Snapshot &) {
+			return EncodeContent(encoding, *body, compressionLevel);
+		});
+		res.set_header("Content-Encoding", encoding);
+	}
+
+	res.set_content(*body, contentType);
+}
+
+// A json body built for this request only. Nothing is cached, but the ETag is over the body:
+// a client gets a 304 as long as nothing it asked for changed.
+inline void SendJsonBody(const httplib::Request &req, httplib::Response &res, const std::string &body, int compressionLevel)
+{
+	std::string encoding;
+	if (compressionLevel > 0 && body.size() >= 256) {
+		encoding = AcceptedEncoding(req);
+	}
+
+	auto etag = "\"" + HashToHex(Fnv1a64(body));
+	if (!encoding.empty()) {
+		etag += "-" + encoding;
+	}
+	etag += "\"";
+
+	res.set_header("Cache-Control", "no-cache");
+	res.set_header("Vary", "Accept-Encoding");
+	if (NotModified(req, res, etag)) {
+		return;
+	}
+
+	if (!encoding.empty()) {
+		res.set_header("Content-Encoding", encoding);
+		res.set_content(EncodeContent(encoding, body, compressionLevel), "application/json");
+	} else {
+		res.set_content(body, "application/json");
+	}
+}
+
+// /api/actors?bbox=&types=, from the grid of the snapshot. Boxes rarely repeat between clients.
+inline void SendFilteredActors(const httplib::Request &req, httplib::Response &res, const SnapshotPtr &snapshot,
+	const ActorSubscription &filter, int compressionLevel)
+{
+	thread_local std::vector<const ActorState *> selected;
+	filter.Select(*snapshot, selected);
+
+	thread_local std::string body;
+	body.clear();
+	GeoJsonWriter(body).FeatureCollection(*snapshot, selected);
+
+	SendJsonBody(req, res, body, compressionLevel);
+}
+
+// /api/actors of snapshot: the shared body when nothing is filtered, else a body of its own
+inline void SendActors(const httplib::Request &req, httplib::Response &res, const SnapshotPtr &snapshot,
+	const ActorSubscription &filter, int compressionLevel)
+{
+	if (filter.IsFiltered()) {
+		SendFilteredActors(req, res, snapshot, filter, compressionLevel);
+	} else {
+		SendSnapshot(req, res, snapshot, "json", "application/json", compressionLevel);
+	}
+}
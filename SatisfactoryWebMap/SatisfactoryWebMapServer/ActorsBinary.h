@@ -0,0 +1,322 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <unordered_map>
+
+// Columnar binary form of one snapshot, served at /api/actors.bin.
+// Shared by the server (writer) and the GUI (reader), so it only depends on the standard library.
+//
+// Everything is little-endian. A 40 byte header:
+//
+//   char[4]  magic       "SWMA"
+//   uint16   version     ActorsBinaryVersion
+//   uint16   flags       ActorsBinaryValid, ActorsBinaryDirectColor
+//   uint64   seq         snapshot version
+//   int64    time        unix time in ms
+//   uint32   count       number of actors
+//   uint32   velocities  number of actors with a velocity
+//   uint32   palette     number of palette colors
+//   uint32   message     error message length
+//
+// followed by the columns, each one packed without padding:
+//
+//   message   char[message]
+//   index     int32[count]           ascending
+//   type      uint8[count]
+//   flags     uint8[count]           ActorHasVelocity
+//   position  int32[count * 3]       x, y, z rounded to cm
+//   rotation  float[count * 3]
+//   velocity  float[velocities * 3]  only for actors with ActorHasVelocity, same order
+//   palette   uint8[palette * 4]     r, g, b, a
+//   color     uint16[count]          palette entry, absent with ActorsBinaryDirectColor
+//                                    (the palette then holds one color per actor)
+
+constexpr uint16_t ActorsBinaryVersion = 1;
+constexpr size_t ActorsBinaryHeaderSize = 40;
+
+enum : uint16_t
+{
+	ActorsBinaryValid = 1 << 0,
+	ActorsBinaryDirectColor = 1 << 1,
+};
+
+enum : uint8_t
+{
+	ActorHasVelocity = 1 << 0,
+};
+
+class ActorsBinaryWriter
+{
+public:
+	explicit ActorsBinaryWriter(size_t reserve = 0)
+	{
+		index.reserve(reserve);
+		type.reserve(reserve);
+		flags.reserve(reserve);
+		position.reserve(reserve * 3);
+		rotation.reserve(reserve * 3);
+		colors.reserve(reserve);
+		color.reserve(reserve);
+	}
+
+	// velocity may be nullptr
+	void Add(int32_t actorIndex, uint8_t actorType, const float location[3], const float actorRotation[3],
+		const float *velocity, const int32_t actorColor[4])
+	{
+		index.push_back(actorIndex);
+		type.push_back(actorType);
+		flags.push_back(velocity ? ActorHasVelocity : 0);
+
+		for (int i = 0; i < 3; ++i) {
+			position.push_back((int32_t)std::lround(location[i]));
+			rotation.push_back(actorRotation[i]);
+		}
+
+		if (velocity) {
+			velocities.insert(velocities.end(), velocity, velocity + 3);
+		}
+
+		uint32_t rgba = 0;
+		for (int i = 0; i < 4; ++i) {
+			rgba |= (uint32_t)(uint8_t)actorColor[i] << (i * 8);
+		}
+		colors.push_back(rgba);
+	}
+
+	std::string Finish(uint64_t seq, int64_t time, bool valid, const std::string &error = "")
+	{
+		// map colors to palette entries, too many distinct colors are stored per actor
+		std::vector<uint32_t> palette;
+		std::unordered_map<uint32_t, uint16_t> lookup;
+		bool direct = false;
+
+		color.clear();
+		for (auto rgba : colors) {
+			auto it = lookup.find(rgba);
+			if (it == lookup.end()) {
+				if (palette.size() > 0xffff) {
+					direct = true;
+					break;
+				}
+				it = lookup.emplace(rgba, (uint16_t)palette.size()).first;
+				palette.push_back(rgba);
+			}
+			color.push_back(it->second);
+		}
+
+		if (direct) {
+			palette = colors;
+			color.clear();
+		}
+
+		std::string out;
+		out.reserve(ActorsBinaryHeaderSize + error.size() + index.size() * 32 + velocities.size() * 4 + palette.size() * 4);
+
+		out.append("SWMA", 4);
+		Put<uint16_t>(out, ActorsBinaryVersion);
+		Put<uint16_t>(out, (valid ? ActorsBinaryValid : 0) | (direct ? ActorsBinaryDirectColor : 0));
+		Put<uint64_t>(out, seq);
+		Put<uint64_t>(out, (uint64_t)time);
+		Put<uint32_t>(out, (uint32_t)index.size());
+		Put<uint32_t>(out, (uint32_t)(velocities.size() / 3));
+		Put<uint32_t>(out, (uint32_t)palette.size());
+		Put<uint32_t>(out, (uint32_t)error.size());
+
+		out += error;
+		for (auto v : index) {
+			Put<uint32_t>(out, (uint32_t)v);
+		}
+		out.append((const char *)type.data(), type.size());
+		out.append((const char *)flags.data(), flags.size());
+		for (auto v : position) {
+			Put<uint32_t>(out, (uint32_t)v);
+		}
+		for (auto v : rotation) {
+			PutFloat(out, v);
+		}
+		for (auto v : velocities) {
+			PutFloat(out, v);
+		}
+		for (auto v : palette) {
+			Put<uint32_t>(out, v);
+		}
+		for (auto v : color) {
+			Put<uint16_t>(out, v);
+		}
+
+		return out;
+	}
+
+private:
+	template <typename T>
+	static void Put(std::string &out, T v)
+	{
+		for (size_t i = 0; i < sizeof(T); ++i) {
+			out += (char)((v >> (i * 8)) & 0xff);
+		}
+	}
+
+	static void PutFloat(std::string &out, float f)
+	{
+		uint32_t v;
+		std::memcpy(&v, &f, sizeof(v));
+		Put<uint32_t>(out, v);
+	}
+
+	std::vector<int32_t> index;
+	std::vector<uint8_t> type;
+	std::vector<uint8_t> flags;
+	std::vector<int32_t> position;
+	std::vector<float> rotation;
+	std::vector<float> velocities;
+	std::vector<uint32_t> colors;
+	std::vector<uint16_t> color;
+};
+
+// Decoded columns, every per-actor array has Count entries (times 3 for vectors)
+struct ActorsBinary
+{
+	uint64_t Seq = 0;
+	int64_t Time = 0;
+	bool Valid = false;
+	std::string Error;
+
+	size_t Count = 0;
+	std::vector<int32_t> Index;
+	std::vector<uint8_t> Type;
+	std::vector<uint8_t> Flags;
+	std::vector<float> Position;
+	std::vector<float> Rotation;
+	std::vector<float> Velocity; // zero for actors without ActorHasVelocity
+	std::vector<uint32_t> Color; // rgba, r in the low byte
+};
+
+// Returns false on truncated or unknown data
+inline bool DecodeActorsBinary(const void *data, size_t size, ActorsBinary &out)
+{
+	auto p = (const uint8_t *)data;
+	auto end = p + size;
+
+	auto get = [&](auto &v) {
+		uint64_t x = 0;
+		for (size_t i = 0; i < sizeof(v); ++i) {
+			x |= (uint64_t)p[i] << (i * 8);
+		}
+		v = (std::remove_reference_t<decltype(v)>)x;
+		p += sizeof(v);
+	};
+
+	auto getFloat = [&](float &f) {
+		uint32_t v;
+		get(v);
+		std::memcpy(&f, &v, sizeof(f));
+	};
+
+	if (size < ActorsBinaryHeaderSize || std::memcmp(p, "SWMA", 4) != 0) {
+		return false;
+	}
+	p += 4;
+
+	uint16_t version, flags;
+	uint64_t seq, time;
+	uint32_t count, velocities, palette, message;
+
+	get(version);
+	get(flags);
+	get(seq);
+	get(time);
+	get(count);
+	get(velocities);
+	get(palette);
+	get(message);
+
+	if (version != ActorsBinaryVersion || velocities > count) {
+		return false;
+	}
+
+	bool direct = flags & ActorsBinaryDirectColor;
+	if (direct ? palette != count : palette > 0x10000) {
+		return false;
+	}
+
+	uint64_t expected = (uint64_t)message + (uint64_t)count * (4 + 1 + 1 + 12 + 12 + (direct ? 0 : 2))
+		+ (uint64_t)velocities * 12 + (uint64_t)palette * 4;
+	if (expected != (uint64_t)(end - p)) {
+		return false;
+	}
+
+	out.Seq = seq;
+	out.Time = (int64_t)time;
+	out.Valid = flags & ActorsBinaryValid;
+	out.Error.assign((const char *)p, message);
+	p += message;
+
+	out.Count = count;
+	out.Index.resize(count);
+	out.Type.resize(count);
+	out.Flags.resize(count);
+	out.Position.resize(count * 3);
+	out.Rotation.resize(count * 3);
+	out.Velocity.assign(count * 3, 0.f);
+	out.Color.resize(count);
+
+	for (auto &v : out.Index) {
+		get(v);
+	}
+
+	std::memcpy(out.Type.data(), p, count);
+	p += count;
+	std::memcpy(out.Flags.data(), p, count);
+	p += count;
+
+	for (auto &v : out.Position) {
+		int32_t cm;
+		get(cm);
+		v = (float)cm;
+	}
+	for (auto &v : out.Rotation) {
+		getFloat(v);
+	}
+
+	uint32_t withVelocity = 0;
+	for (size_t i = 0; i < count; ++i) {
+		if (!(out.Flags[i] & ActorHasVelocity)) {
+			continue;
+		}
+		if (++withVelocity > velocities) {
+			return false;
+		}
+
+		for (int k = 0; k < 3; ++k) {
+			getFloat(out.Velocity[i * 3 + k]);
+		}
+	}
+	if (withVelocity != velocities) {
+		return false;
+	}
+
+	std::vector<uint32_t> colors(palette);
+	for (auto &v : colors) {
+		get(v);
+	}
+
+	if (direct) {
+		out.Color = std::move(colors);
+	} else {
+		for (auto &v : out.Color) {
+			uint16_t entry;
+			get(entry);
+			if (entry >= palette) {
+				return false;
+			}
+			v = colors[entry];
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,312 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include <nlohmann/json.hpp>
+
+#include "../SatisfactoryWebMap/Image.h"
+
+#include "Hash.h"
+#include "PngWriter.h"
+#include "SpatialGrid.h"
+#include "TileCache.h"
+#include "WorkerPool.h"
+
+// The map image of the web root cut into 256 pixel PNG tiles for the zooms of the web page.
+//
+// Tiles use the CRS.Simple projection of main.js, the same as /tiles/actors: world (x, y) is at
+// pixel (x * 2^z, y * 2^z) and the image covers the map bounds. The finest zoom is the first one
+// at which the image is not upscaled by more than 2x, every coarser zoom cuts from the previous
+// level's image halved with Image::resize, so each level reads about a quarter of the pixels of
+// the one before. The tiles of a level are cut in parallel on a pool of its own, so the snapshot
+// thread never waits for them.
+//
+// The pyramid is written to <cache>/<source hash>/<z>/<x>_<y>.png, pyramid.json last. A cache with
+// pyramid.json is complete and used as is, a changed map.png gets a new directory. When the image
+// cannot be decoded or a tile cannot be written, Info() says so and the page keeps the whole image.
+class BaseMapTiles
+{
+public:
+	static constexpr int TileSize = 256;
+
+	BaseMapTiles() : memory(16 << 20)
+	{}
+
+	BaseMapTiles(const BaseMapTiles &) = delete;
+	BaseMapTiles &operator=(const BaseMapTiles &) = delete;
+
+	~BaseMapTiles()
+	{
+		Stop();
+	}
+
+	// Uses the cached pyramid of source, or starts cutting it in the background.
+	// Returns false when source cannot be read.
+	bool Start(const std::string &source, const std::string &cacheRoot, int threads, int compressionLevel)
+	{
+		namespace fs = std::filesystem;
+
+		std::ifstream ifs(source, std::ios::binary);
+		if (!ifs) {
+			return false;
+		}
+		auto bytes = std::make_shared<std::string>((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+		dir = (fs::path(cacheRoot) / HashToHex(Fnv1a64(*bytes))).string();
+		if (LoadInfo()) {
+			return true;
+		}
+
+		worker = std::thread([this, bytes, threads, compressionLevel] {
+			Generate(*bytes, threads, compressionLevel);
+		});
+		return true;
+	}
+
+	// Stops cutting, the tiles cut so far stay in the cache but the pyramid is not used
+	// until it is complete
+	void Stop()
+	{
+		stopping = true;
+		if (worker.joinable()) {
+			worker.join();
+		}
+	}
+
+	bool Ready() const
+	{
+		return ready;
+	}
+
+	// /tiles/base/info.json
+	std::string Info() const
+	{
+		if (failed) {
+			return nlohmann::json({ { "ready", false }, { "status", "err" }, { "msg", failure } }).dump();
+		}
+		if (!ready) {
+			return R"({"ready":false,"status":"ok"})";
+		}
+		return "{\"max_zoom\":" + std::to_string(maxZoom) + ",\"min_zoom\":" + std::to_string(minZoom) +
+			",\"ready\":true,\"status\":\"ok\"}";
+	}
+
+	// PNG of a tile, nullptr when it is outside the map or not cut yet
+	std::shared_ptr<const std::string> Get(int z, int x, int y)
+	{
+		if (!ready || z < minZoom || z > maxZoom) {
+			return nullptr;
+		}
+
+		const int32_t id[3] = { z, x, y };
+		auto body = memory.Get(Fnv1a64(id, sizeof(id)), [&] {
+			std::ifstream ifs(TilePath(z, x, y), std::ios::binary);
+			return ifs ? std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>()) : std::string();
+		});
+		return body->empty() ? nullptr : body;
+	}
+
+private:
+	// size of the map in pixels at zoom z
+	static double MapWidth(int z)
+	{
+		return std::ldexp((double)MapMaxX - MapMinX, z);
+	}
+
+	static double MapHeight(int z)
+	{
+		return std::ldexp((double)MapMaxY - MapMinY, z);
+	}
+
+	std::string TilePath(int z, int x, int y) const
+	{
+		return dir + "/" + std::to_string(z) + "/" + std::to_string(x) + "_" + std::to_string(y) + ".png";
+	}
+
+	bool LoadInfo()
+	{
+		std::ifstream ifs(dir + "/pyramid.json");
+		if (!ifs) {
+			return false;
+		}
+
+		try {
+			nlohmann::json j;
+			ifs >> j;
+			minZoom = j.at("min_zoom").get<int>();
+			maxZoom = j.at("max_zoom").get<int>();
+		} catch (const std::exception &) {
+			return false;
+		}
+
+		ready = minZoom <= maxZoom;
+		return ready;
+	}
+
+	void Generate(const std::string &bytes, int threads, int compressionLevel)
+	{
+		namespace fs = std::filesystem;
+
+		auto level = Image::from_bytes((const uint8_t *)bytes.data(), bytes.size());
+		if (!level) {
+			Fail("unable to decode img/map.png");
+			return;
+		}
+		if (level.ch != 4) {
+			Fail("img/map.png is not RGBA");
+			return;
+		}
+
+		int finest = (int)std::ceil(std::log2(level.width / MapWidth(0)));
+		int coarsest = (std::min)(finest, (int)std::floor(std::log2(TileSize / MapWidth(0))));
+
+		WorkerPool pool((std::max)(threads, 1));
+		for (int z = finest; z >= coarsest && !stopping; --z) {
+			if (z < finest) {
+				level = level.resize((std::max)(level.width / 2, 1), (std::max)(level.height / 2, 1));
+				if (!level) {
+					Fail("out of memory halving img/map.png");
+					return;
+				}
+			}
+
+			std::error_code ec;
+			fs::create_directories(dir + "/" + std::to_string(z), ec);
+
+			const double originX = std::ldexp((double)MapMinX, z), originY = std::ldexp((double)MapMinY, z);
+			const int x0 = (int)std::floor(originX / TileSize), x1 = (int)std::ceil((originX + MapWidth(z)) / TileSize);
+			const int y0 = (int)std::floor(originY / TileSize), y1 = (int)std::ceil((originY + MapHeight(z)) / TileSize);
+			const int columns = x1 - x0;
+
+			std::atomic<bool> cut = true;
+			pool.ParallelFor(columns * (y1 - y0), [&](int i) {
+				if (!stopping && cut && !CutTile(level, z, x0 + i % columns, y0 + i / columns, compressionLevel)) {
+					cut = false;
+				}
+			});
+			if (!cut) {
+				Fail("unable to write the tiles of zoom " + std::to_string(z) + " to " + dir);
+				return;
+			}
+		}
+
+		if (stopping) {
+			return;
+		}
+
+		// last, its presence means every tile is there
+		if (!WriteFile(dir + "/pyramid.json", nlohmann::json({ { "min_zoom", coarsest }, { "max_zoom", finest } }).dump() + "\n")) {
+			Fail("unable to write " + dir + "/pyramid.json");
+			return;
+		}
+
+		minZoom = coarsest;
+		maxZoom = finest;
+		ready = true;
+	}
+
+	// Writes path.tmp and renames it over path, so a reader never sees half a file.
+	// A failed write leaves nothing behind.
+	static bool WriteFile(const std::string &path, const std::string &body)
+	{
+		std::error_code ec;
+		{
+			std::ofstream ofs(path + ".tmp", std::ios::binary);
+			ofs.write(body.data(), body.size());
+			ofs.close();
+			if (!ofs) {
+				std::filesystem::remove(path + ".tmp", ec);
+				return false;
+			}
+		}
+
+		std::filesystem::rename(path + ".tmp", path, ec);
+		if (ec) {
+			std::filesystem::remove(path + ".tmp", ec);
+			return false;
+		}
+		return true;
+	}
+
+	void Fail(const std::string &message)
+	{
+		failure = message;
+		failed = true;
+#ifdef _WIN32
+		OutputDebugStringA(("Base map tiles: " + message).c_str());
+#endif
+	}
+
+	// Crops the part of level under tile (x, y), scales it to tile pixels and writes the PNG.
+	// False when it could not, a tile outside the image is not an error.
+	bool CutTile(const Image &level, int z, int x, int y, int compressionLevel)
+	{
+		// level pixels per tile pixel
+		const double sx = level.width / MapWidth(z), sy = level.height / MapHeight(z);
+		const double originX = std::ldexp((double)MapMinX, z), originY = std::ldexp((double)MapMinY, z);
+
+		// tile in level pixels, clipped to the image
+		auto clip = [](double v, int size) {
+			return (int)(std::min)((std::max)(std::round(v), 0.), (double)size);
+		};
+		int left = clip(((double)x * TileSize - originX) * sx, level.width);
+		int right = clip(((double)(x + 1) * TileSize - originX) * sx, level.width);
+		int top = clip(((double)y * TileSize - originY) * sy, level.height);
+		int bottom = clip(((double)(y + 1) * TileSize - originY) * sy, level.height);
+		if (left >= right || top >= bottom) {
+			return true;
+		}
+
+		// and where that lands in the tile
+		int dx0 = (int)std::round(left / sx + originX - (double)x * TileSize);
+		int dx1 = (int)std::round(right / sx + originX - (double)x * TileSize);
+		int dy0 = (int)std::round(top / sy + originY - (double)y * TileSize);
+		int dy1 = (int)std::round(bottom / sy + originY - (double)y * TileSize);
+		dx0 = (std::max)(dx0, 0);
+		dy0 = (std::max)(dy0, 0);
+		dx1 = (std::min)(dx1, TileSize);
+		dy1 = (std::min)(dy1, TileSize);
+		if (dx0 >= dx1 || dy0 >= dy1) {
+			return true;
+		}
+
+		auto piece = level.crop(left, top, level.width - right, level.height - bottom).resize(dx1 - dx0, dy1 - dy0);
+		if (!piece) {
+			return false;
+		}
+
+		auto tile = Image::empty(TileSize, TileSize, 4);
+		if (!tile) {
+			return false;
+		}
+		bitblt(tile.data + ((size_t)dy0 * TileSize + dx0) * 4, TileSize * 4, piece.data, (size_t)piece.width * 4,
+			(size_t)piece.width * 4, piece.height);
+
+		return WriteFile(TilePath(z, x, y), EncodePng(tile.data, TileSize, TileSize, (std::max)(compressionLevel, 1)));
+	}
+
+	std::string dir;
+	std::thread worker;
+	std::atomic<bool> stopping = false;
+
+	std::atomic<bool> ready = false;
+	std::atomic<bool> failed = false;
+	std::string failure; // set before failed
+	int minZoom = 0, maxZoom = -1;
+
+	TileCache memory;
+};
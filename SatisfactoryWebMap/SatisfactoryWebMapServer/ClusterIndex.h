@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "SpatialGrid.h"
+
+// Actors merged into clusters for every zoom level of the web map, built once per snapshot.
+//
+// Zoom is the Leaflet zoom of main.js (CRS.Simple, one world unit is 2^z pixels). A level groups
+// actors by square cells of Radius pixels at its zoom, anchored at the map corner, so every cell
+// is exactly 2x2 cells of the next finer level: the finest level is sorted once and each coarser
+// level is merged from the one below, a tree rather than independent passes. Centroids are the
+// mean position of the members.
+class ClusterIndex
+{
+public:
+	static constexpr int MinZoom = -12;
+	static constexpr int MaxZoom = -4; // above it every actor is shown on its own
+	static constexpr int Radius = 64; // cell size in pixels
+
+	struct Cluster
+	{
+		uint64_t Key; // row * columns + column
+		float Location[3];
+		uint32_t Count;
+		uint32_t First; // position of the lowest member in the actor array
+	};
+
+	template <typename Actor>
+	void Build(const std::vector<Actor> &actors)
+	{
+		levels.assign(MaxZoom - MinZoom + 1, {});
+
+		struct Sum
+		{
+			uint64_t Key;
+			double Location[3];
+			uint32_t Count;
+			uint32_t First;
+		};
+
+		// finest level straight from the actors, positions ascending within a cell
+		auto &finest = levels.back();
+		std::vector<std::pair<uint64_t, uint32_t>> keyed(actors.size());
+		for (uint32_t i = 0; i < (uint32_t)actors.size(); ++i) {
+			keyed[i] = { KeyOf(MaxZoom, actors[i].Location[0], actors[i].Location[1]), i };
+		}
+		std::sort(keyed.begin(), keyed.end());
+
+		std::vector<Sum> sums;
+		for (const auto &item : keyed) {
+			const auto &loc = actors[item.second].Location;
+			if (sums.empty() || sums.back().Key != item.first) {
+				sums.push_back({ item.first, { 0., 0., 0. }, 0, item.second });
+			}
+
+			auto &sum = sums.back();
+			for (int k = 0; k < 3; ++k) {
+				sum.Location[k] += loc[k];
+			}
+			++sum.Count;
+		}
+		Store(sums, finest);
+
+		// each coarser level from the one below
+		for (int z = MaxZoom - 1; z >= MinZoom; --z) {
+			const auto &children = sums;
+			std::vector<Sum> parents;
+
+			const uint64_t childColumns = Columns(z + 1), columns = Columns(z);
+			std::vector<std::pair<uint64_t, uint32_t>> order(children.size());
+			for (uint32_t i = 0; i < (uint32_t)children.size(); ++i) {
+				auto key = children[i].Key;
+				order[i] = { (key / childColumns / 2) * columns + (key % childColumns) / 2, i };
+			}
+			std::sort(order.begin(), order.end());
+
+			for (const auto &item : order) {
+				const auto &child = children[item.second];
+				if (parents.empty() || parents.back().Key != item.first) {
+					parents.push_back({ item.first, { 0., 0., 0. }, 0, child.First });
+				}
+
+				auto &parent = parents.back();
+				for (int k = 0; k < 3; ++k) {
+					parent.Location[k] += child.Location[k];
+				}
+				parent.Count += child.Count;
+				parent.First = (std::min)(parent.First, child.First);
+			}
+
+			sums = std::move(parents);
+			Store(sums, levels[z - MinZoom]);
+		}
+	}
+
+	// Clusters of the level for zoom whose centroid is inside box (minX, minY, maxX, maxY),
+	// ordered by cell. zoom must be within [MinZoom, MaxZoom].
+	void Query(int zoom, const float box[4], std::vector<const Cluster *> &out) const
+	{
+		out.clear();
+		if (zoom < MinZoom || zoom > MaxZoom || levels.empty() || box[0] > box[2] || box[1] > box[3]) {
+			return;
+		}
+
+		const auto &level = levels[zoom - MinZoom];
+		const uint64_t columns = Columns(zoom);
+		const uint64_t x0 = Cell(zoom, box[0] - MapMinX, columns), x1 = Cell(zoom, box[2] - MapMinX, columns);
+		const uint64_t y0 = Cell(zoom, box[1] - MapMinY, Rows(zoom)), y1 = Cell(zoom, box[3] - MapMinY, Rows(zoom));
+
+		auto before = [](const Cluster &cluster, uint64_t key) { return cluster.Key < key; };
+		for (uint64_t y = y0; y <= y1; ++y) {
+			auto it = std::lower_bound(level.begin(), level.end(), y * columns + x0, before);
+			for (; it != level.end() && it->Key <= y * columns + x1; ++it) {
+				const auto &loc = it->Location;
+				if (loc[0] >= box[0] && loc[1] >= box[1] && loc[0] <= box[2] && loc[1] <= box[3]) {
+					out.push_back(&*it);
+				}
+			}
+		}
+	}
+
+	// Stable across snapshots as long as the cell is, and different between levels
+	static uint64_t ClusterId(int zoom, const Cluster &cluster)
+	{
+		return cluster.Key * 32 + (uint64_t)(zoom - MinZoom);
+	}
+
+	// Cell size in world units
+	static double CellSize(int zoom)
+	{
+		return std::ldexp((double)Radius, -zoom);
+	}
+
+private:
+	template <typename Sum>
+	static void Store(const std::vector<Sum> &sums, std::vector<Cluster> &level)
+	{
+		level.resize(sums.size());
+		for (size_t i = 0; i < sums.size(); ++i) {
+			const auto &sum = sums[i];
+			auto &cluster = level[i];
+			cluster.Key = sum.Key;
+			for (int k = 0; k < 3; ++k) {
+				cluster.Location[k] = (float)(sum.Location[k] / sum.Count);
+			}
+			cluster.Count = sum.Count;
+			cluster.First = sum.First;
+		}
+	}
+
+	static uint64_t Columns(int zoom)
+	{
+		return (uint64_t)std::ceil((MapMaxX - MapMinX) / CellSize(zoom));
+	}
+
+	static uint64_t Rows(int zoom)
+	{
+		return (uint64_t)std::ceil((MapMaxY - MapMinY) / CellSize(zoom));
+	}
+
+	// Actors outside the map stay in the border cells, NaN goes to the first one
+	static uint64_t Cell(int zoom, double offset, uint64_t count)
+	{
+		double cell = offset / CellSize(zoom);
+		return cell >= 0. ? (cell < (double)count ? (uint64_t)cell : count - 1) : 0;
+	}
+
+	static uint64_t KeyOf(int zoom, float x, float y)
+	{
+		const uint64_t columns = Columns(zoom);
+		return Cell(zoom, (double)y - MapMinY, Rows(zoom)) * columns + Cell(zoom, (double)x - MapMinX, columns);
+	}
+
+	// MinZoom first
+	std::vector<std::vector<Cluster>> levels;
+};
@@ -16,12 +16,34 @@ struct Config
     int Port;
     std::string Root;
     bool APIOnly;
+    int Threads;
+    int MaxStreams;
+    int WebSocketPort;
+    int CompressionLevel;
 
     // game sdk params
     size_t TNameEntryArrayOffset;
     size_t GUObjectArrayOffset;
 
     std::string MapManagerName;
+    int ScanThreads;
+
+    // snapshot thread params
+    int SnapshotInterval;
+    int DeltaHistory;
+
+    // longest time between two reads of an actor that does not move, 0 reads every actor every time
+    int IdleSampleMs;
+
+    // base map tiles, next to the dll when empty
+    std::string TileCacheDir;
+
+    // /api/history, trails of static representations too
+    bool HistoryStatic;
+
+    // /api/actors?at=, next to the dll when empty, 0 MB turns it off
+    std::string SnapshotLogDir;
+    int SnapshotLogMB;
 
     void Save(const std::string &configFile)
     {
@@ -34,9 +56,25 @@ struct Config
             j["root"] = Root;
         }
         j["apionly"] = APIOnly;
+        j["threads"] = Threads;
+        j["max_streams"] = MaxStreams;
+        j["ws_port"] = WebSocketPort;
+        j["compression_level"] = CompressionLevel;
         j["gnames_offset"] = TNameEntryArrayOffset;
         j["gobjects_offset"] = GUObjectArrayOffset;
         j["mapmanager_name"] = MapManagerName;
+        j["scan_threads"] = ScanThreads;
+        j["snapshot_interval"] = SnapshotInterval;
+        j["delta_history"] = DeltaHistory;
+        j["idle_sample_ms"] = IdleSampleMs;
+        if (!TileCacheDir.empty()) {
+            j["tile_cache"] = TileCacheDir;
+        }
+        j["history_static"] = HistoryStatic;
+        if (!SnapshotLogDir.empty()) {
+            j["snapshot_log"] = SnapshotLogDir;
+        }
+        j["snapshot_log_mb"] = SnapshotLogMB;
 
         o << std::setw(4) << j << std::endl;
     }
@@ -44,8 +82,12 @@ struct Config
     static Config Load(const std::string &configFile)
     {
         Config config{
-            "0.0.0.0", 7012, "", false,
-            0x4004A78, 0x4008F80, "MapManager",
+            "0.0.0.0", 7012, "", false, 16, 8, 7013, 6,
+            0x4004A78, 0x4008F80, "MapManager", 4,
+            1000, 64, 2000,
+            "",
+            false,
+            "", 1024,
         };
 
         std::ifstream i(configFile);
@@ -72,6 +114,22 @@ struct Config
             config.APIOnly = j["apionly"].get<bool>();
         }
 
+        if (j.find("threads") != j.end()) {
+            config.Threads = j["threads"].get<int>();
+        }
+
+        if (j.find("max_streams") != j.end()) {
+            config.MaxStreams = j["max_streams"].get<int>();
+        }
+
+        if (j.find("ws_port") != j.end()) {
+            config.WebSocketPort = j["ws_port"].get<int>();
+        }
+
+        if (j.find("compression_level") != j.end()) {
+            config.CompressionLevel = j["compression_level"].get<int>();
+        }
+
         if (j.find("gnames_offset") != j.end()) {
             config.TNameEntryArrayOffset = j["gnames_offset"].get<size_t>();
         }
@@ -84,6 +142,38 @@ struct Config
             config.MapManagerName = j["mapmanager_name"].get<std::string>();
         }
 
+        if (j.find("scan_threads") != j.end()) {
+            config.ScanThreads = j["scan_threads"].get<int>();
+        }
+
+        if (j.find("snapshot_interval") != j.end()) {
+            config.SnapshotInterval = j["snapshot_interval"].get<int>();
+        }
+
+        if (j.find("delta_history") != j.end()) {
+            config.DeltaHistory = j["delta_history"].get<int>();
+        }
+
+        if (j.find("idle_sample_ms") != j.end()) {
+            config.IdleSampleMs = j["idle_sample_ms"].get<int>();
+        }
+
+        if (j.find("tile_cache") != j.end()) {
+            config.TileCacheDir = j["tile_cache"].get<std::string>();
+        }
+
+        if (j.find("history_static") != j.end()) {
+            config.HistoryStatic = j["history_static"].get<bool>();
+        }
+
+        if (j.find("snapshot_log") != j.end()) {
+            config.SnapshotLogDir = j["snapshot_log"].get<std::string>();
+        }
+
+        if (j.find("snapshot_log_mb") != j.end()) {
+            config.SnapshotLogMB = j["snapshot_log_mb"].get<int>();
+        }
+
         return config;
     }
 };
@@ -0,0 +1,601 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <queue>
+#include <algorithm>
+
+// DEFLATE (RFC 1951) compressor with gzip and zlib wrappers, enough to serve
+// Content-Encoding: gzip / deflate without linking zlib. Compression only.
+//
+// LZ77 over hash chains with optional lazy matching, one dynamic Huffman
+// block per 64k tokens (fixed codes when those come out smaller).
+// level 0 stores, 1-9 trade speed for ratio like zlib.
+
+namespace deflate {
+
+inline uint32_t Crc32(const void *data, size_t size, uint32_t crc = 0)
+{
+	static const auto table = [] {
+		std::vector<uint32_t> t(256);
+		for (uint32_t i = 0; i < 256; ++i) {
+			uint32_t c = i;
+			for (int k = 0; k < 8; ++k) {
+				c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			t[i] = c;
+		}
+		return t;
+	}();
+
+	auto p = (const uint8_t *)data;
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i) {
+		crc = table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+inline uint32_t Adler32(const void *data, size_t size)
+{
+	auto p = (const uint8_t *)data;
+	uint32_t a = 1, b = 0;
+
+	while (size > 0) {
+		// largest n for which b cannot overflow before the modulo
+		size_t n = std::min<size_t>(size, 5552);
+		size -= n;
+		while (n--) {
+			a += *p++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return b << 16 | a;
+}
+
+namespace detail {
+
+class BitWriter
+{
+public:
+	explicit BitWriter(std::string &out) : out(out)
+	{}
+
+	// LSB first, as DEFLATE packs everything except Huffman codes
+	void Put(uint32_t value, int n)
+	{
+		bits |= (uint64_t)value << count;
+		count += n;
+		while (count >= 8) {
+			out += (char)(bits & 0xff);
+			bits >>= 8;
+			count -= 8;
+		}
+	}
+
+	void Align()
+	{
+		if (count > 0) {
+			Put(0, 8 - count);
+		}
+	}
+
+private:
+	std::string &out;
+	uint64_t bits = 0;
+	int count = 0;
+};
+
+struct Tables
+{
+	uint16_t LengthBase[29];
+	uint8_t LengthExtra[29];
+	uint16_t DistBase[30];
+	uint8_t DistExtra[30];
+
+	uint16_t LengthCode[259]; // match length -> symbol - 257
+	uint8_t DistCode[512];    // see DistSymbol
+
+	Tables()
+	{
+		static const uint8_t lengthExtra[29] = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+		static const uint8_t distExtra[30] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+
+		uint16_t base = 3;
+		for (int i = 0; i < 28; ++i) {
+			LengthBase[i] = base;
+			LengthExtra[i] = lengthExtra[i];
+			for (int k = 0; k < (1 << lengthExtra[i]); ++k) {
+				LengthCode[base + k] = (uint16_t)i;
+			}
+			base += (uint16_t)(1 << lengthExtra[i]);
+		}
+		LengthBase[28] = 258;
+		LengthExtra[28] = 0;
+		LengthCode[258] = 28;
+
+		uint32_t dist = 1;
+		for (int i = 0; i < 30; ++i) {
+			DistBase[i] = (uint16_t)dist;
+			DistExtra[i] = distExtra[i];
+			dist += 1u << distExtra[i];
+		}
+
+		// distances up to 256 index directly, larger ones by (dist - 1) >> 7
+		for (int i = 0; i < 30; ++i) {
+			for (uint32_t d = DistBase[i]; d < DistBase[i] + (1u << DistExtra[i]); ++d) {
+				if (d <= 256) {
+					DistCode[d - 1] = (uint8_t)i;
+				} else {
+					DistCode[256 + ((d - 1) >> 7)] = (uint8_t)i;
+				}
+			}
+		}
+	}
+
+	int DistSymbol(uint32_t dist) const
+	{
+		return dist <= 256 ? DistCode[dist - 1] : DistCode[256 + ((dist - 1) >> 7)];
+	}
+
+	static const Tables &Get()
+	{
+		static const Tables tables;
+		return tables;
+	}
+};
+
+// Huffman code lengths no longer than maxBits, zero for unused symbols
+inline void BuildLengths(const uint32_t *freq, int n, int maxBits, uint8_t *lengths)
+{
+	std::vector<uint32_t> f(freq, freq + n);
+	std::fill(lengths, lengths + n, 0);
+
+	int used = 0, last = 0;
+	for (int i = 0; i < n; ++i) {
+		if (f[i]) {
+			++used;
+			last = i;
+		}
+	}
+
+	if (used == 0) {
+		return;
+	}
+	if (used == 1) {
+		lengths[last] = 1;
+		return;
+	}
+
+	for (;;) {
+		// nodes: leaves 0..n-1, internal nodes after
+		std::vector<int> parent(n * 2, -1);
+		using Node = std::pair<uint64_t, int>;
+		std::priority_queue<Node, std::vector<Node>, std::greater<Node>> heap;
+
+		for (int i = 0; i < n; ++i) {
+			if (f[i]) {
+				heap.push({ f[i], i });
+			}
+		}
+
+		int next = n;
+		while (heap.size() > 1) {
+			auto a = heap.top();
+			heap.pop();
+			auto b = heap.top();
+			heap.pop();
+
+			parent[a.second] = next;
+			parent[b.second] = next;
+			heap.push({ a.first + b.first, next++ });
+		}
+
+		int longest = 0;
+		for (int i = 0; i < n; ++i) {
+			if (!f[i]) {
+				continue;
+			}
+
+			int depth = 0;
+			for (int node = i; parent[node] != -1; node = parent[node]) {
+				++depth;
+			}
+			lengths[i] = (uint8_t)depth;
+			longest = (std::max)(longest, depth);
+		}
+
+		if (longest <= maxBits) {
+			return;
+		}
+
+		// flatten the distribution and retry
+		for (auto &v : f) {
+			if (v) {
+				v = (v >> 1) | 1;
+			}
+		}
+	}
+}
+
+// Canonical codes, bit reversed so they can go through BitWriter::Put
+inline void BuildCodes(const uint8_t *lengths, int n, uint16_t *codes)
+{
+	uint16_t count[16] = {}, next[16] = {};
+	for (int i = 0; i < n; ++i) {
+		count[lengths[i]]++;
+	}
+	count[0] = 0;
+
+	uint16_t code = 0;
+	for (int bits = 1; bits < 16; ++bits) {
+		code = (uint16_t)((code + count[bits - 1]) << 1);
+		next[bits] = code;
+	}
+
+	for (int i = 0; i < n; ++i) {
+		int len = lengths[i];
+		if (len == 0) {
+			codes[i] = 0;
+			continue;
+		}
+
+		uint16_t c = next[len]++, r = 0;
+		for (int k = 0; k < len; ++k) {
+			r = (uint16_t)((r << 1) | ((c >> k) & 1));
+		}
+		codes[i] = r;
+	}
+}
+
+// literal: the byte, match: MatchFlag | length << 16 | distance
+constexpr uint32_t MatchFlag = 0x80000000u;
+
+inline void WriteBlock(BitWriter &bw, const std::vector<uint32_t> &tokens, bool final)
+{
+	const auto &t = Tables::Get();
+
+	uint32_t litFreq[286] = {}, distFreq[30] = {};
+	for (auto token : tokens) {
+		if (token & MatchFlag) {
+			litFreq[257 + t.LengthCode[(token >> 16) & 0x1ff]]++;
+			distFreq[t.DistSymbol(token & 0xffff)]++;
+		} else {
+			litFreq[token]++;
+		}
+	}
+	litFreq[256] = 1;
+
+	// 288 entries for the fixed codes, whose last two symbols have a length too,
+	// a dynamic header only sends the first 286
+	uint8_t litLen[288] = {}, distLen[30];
+	BuildLengths(litFreq, 286, 15, litLen);
+	BuildLengths(distFreq, 30, 15, distLen);
+
+	// a dynamic block needs at least one distance code
+	if (std::count(distLen, distLen + 30, 0) == 30) {
+		distLen[0] = 1;
+	}
+
+	int numLit = 286, numDist = 30;
+	while (numLit > 257 && litLen[numLit - 1] == 0) {
+		--numLit;
+	}
+	while (numDist > 1 && distLen[numDist - 1] == 0) {
+		--numDist;
+	}
+
+	// run-length encode both length tables as one sequence
+	std::vector<uint8_t> all(litLen, litLen + numLit);
+	all.insert(all.end(), distLen, distLen + numDist);
+
+	std::vector<std::pair<uint8_t, uint8_t>> runs; // symbol, extra value
+	uint32_t clFreq[19] = {};
+	for (size_t i = 0; i < all.size();) {
+		size_t run = 1;
+		while (i + run < all.size() && all[i + run] == all[i]) {
+			++run;
+		}
+
+		if (all[i] == 0 && run >= 3) {
+			run = std::min<size_t>(run, 138);
+			if (run <= 10) {
+				runs.push_back({ 17, (uint8_t)(run - 3) });
+			} else {
+				runs.push_back({ 18, (uint8_t)(run - 11) });
+			}
+		} else if (all[i] != 0 && run >= 4) {
+			runs.push_back({ all[i], 0 });
+			run = std::min<size_t>(run - 1, 6);
+			runs.push_back({ 16, (uint8_t)(run - 3) });
+			++run;
+		} else {
+			run = 1;
+			runs.push_back({ all[i], 0 });
+		}
+
+		i += run;
+	}
+	for (auto &r : runs) {
+		clFreq[r.first]++;
+	}
+
+	static const uint8_t clOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	uint8_t clLen[19];
+	BuildLengths(clFreq, 19, 7, clLen);
+
+	int numCl = 19;
+	while (numCl > 4 && clLen[clOrder[numCl - 1]] == 0) {
+		--numCl;
+	}
+
+	// compare against the fixed codes
+	uint64_t dynamicBits = 5 + 5 + 4 + 3 * (uint64_t)numCl, fixedBits = 0;
+	for (auto &r : runs) {
+		dynamicBits += clLen[r.first] + (r.first == 16 ? 2 : r.first == 17 ? 3 : r.first == 18 ? 7 : 0);
+	}
+	for (int i = 0; i < 286; ++i) {
+		int extra = i > 256 ? t.LengthExtra[i - 257] : 0;
+		int fixedLen = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+		dynamicBits += (uint64_t)litFreq[i] * (litLen[i] + extra);
+		fixedBits += (uint64_t)litFreq[i] * (fixedLen + extra);
+	}
+	for (int i = 0; i < 30; ++i) {
+		dynamicBits += (uint64_t)distFreq[i] * (distLen[i] + t.DistExtra[i]);
+		fixedBits += (uint64_t)distFreq[i] * (5 + t.DistExtra[i]);
+	}
+
+	uint16_t litCode[288], distCode[30];
+
+	bw.Put(final ? 1 : 0, 1);
+	if (fixedBits <= dynamicBits) {
+		bw.Put(1, 2);
+
+		for (int i = 0; i < 288; ++i) {
+			litLen[i] = (uint8_t)(i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8);
+		}
+		std::fill(distLen, distLen + 30, 5);
+	} else {
+		bw.Put(2, 2);
+		bw.Put(numLit - 257, 5);
+		bw.Put(numDist - 1, 5);
+		bw.Put(numCl - 4, 4);
+		for (int i = 0; i < numCl; ++i) {
+			bw.Put(clLen[clOrder[i]], 3);
+		}
+
+		uint16_t clCode[19];
+		BuildCodes(clLen, 19, clCode);
+		for (auto &r : runs) {
+			bw.Put(clCode[r.first], clLen[r.first]);
+			if (r.first == 16) {
+				bw.Put(r.second, 2);
+			} else if (r.first == 17) {
+				bw.Put(r.second, 3);
+			} else if (r.first == 18) {
+				bw.Put(r.second, 7);
+			}
+		}
+	}
+
+	BuildCodes(litLen, 288, litCode);
+	BuildCodes(distLen, 30, distCode);
+
+	for (auto token : tokens) {
+		if (token & MatchFlag) {
+			uint32_t len = (token >> 16) & 0x1ff, dist = token & 0xffff;
+			int lc = t.LengthCode[len], dc = t.DistSymbol(dist);
+
+			bw.Put(litCode[257 + lc], litLen[257 + lc]);
+			bw.Put(len - t.LengthBase[lc], t.LengthExtra[lc]);
+			bw.Put(distCode[dc], distLen[dc]);
+			bw.Put(dist - t.DistBase[dc], t.DistExtra[dc]);
+		} else {
+			bw.Put(litCode[token], litLen[token]);
+		}
+	}
+	bw.Put(litCode[256], litLen[256]);
+}
+
+}
+
+// Raw DEFLATE stream
+inline std::string Compress(const void *data, size_t size, int level = 6)
+{
+	using namespace detail;
+
+	std::string out;
+	BitWriter bw(out);
+	auto in = (const uint8_t *)data;
+
+	if (level <= 0) {
+		size_t pos = 0;
+		do {
+			size_t n = std::min<size_t>(size - pos, 0xffff);
+			bw.Put(pos + n == size ? 1 : 0, 1);
+			bw.Put(0, 2);
+			bw.Align();
+			bw.Put((uint32_t)n, 16);
+			bw.Put((uint32_t)~n & 0xffff, 16);
+			out.append((const char *)in + pos, n);
+			pos += n;
+		} while (pos < size);
+		return out;
+	}
+
+	static const int chains[10] = { 0, 4, 8, 16, 32, 64, 128, 256, 1024, 4096 };
+	const int maxChain = chains[(std::min)(level, 9)];
+	const bool lazy = level >= 4;
+
+	constexpr uint32_t WindowSize = 1 << 15, WindowMask = WindowSize - 1;
+	constexpr uint32_t HashSize = 1 << 15;
+	constexpr size_t BlockTokens = 1 << 16;
+
+	std::vector<int32_t> head(HashSize, -1), prev(WindowSize, -1);
+	std::vector<uint32_t> tokens;
+	tokens.reserve(BlockTokens);
+
+	auto hash = [&](size_t i) {
+		return ((uint32_t)in[i] << 10 ^ (uint32_t)in[i + 1] << 5 ^ in[i + 2]) & (HashSize - 1);
+	};
+
+	auto insert = [&](size_t i) {
+		if (i + 2 < size) {
+			auto h = hash(i);
+			prev[i & WindowMask] = head[h];
+			head[h] = (int32_t)i;
+		}
+	};
+
+	// longest earlier match for position i, must be called before insert(i)
+	auto find = [&](size_t i, uint32_t &bestDist) {
+		uint32_t best = 0;
+		if (i + 2 >= size) {
+			return best;
+		}
+
+		size_t maxLen = std::min<size_t>(258, size - i);
+		int32_t cand = head[hash(i)];
+
+		for (int chain = maxChain; cand >= 0 && chain > 0; --chain) {
+			if (i - cand > WindowSize) {
+				break;
+			}
+
+			if (in[cand + best] == in[i + best]) {
+				size_t len = 0;
+				while (len < maxLen && in[cand + len] == in[i + len]) {
+					++len;
+				}
+
+				if (len > best) {
+					best = (uint32_t)len;
+					bestDist = (uint32_t)(i - cand);
+					if (len == maxLen) {
+						break;
+					}
+				}
+			}
+
+			auto next = prev[cand & WindowMask];
+			if (next >= cand) {
+				break;
+			}
+			cand = next;
+		}
+
+		return best >= 3 ? best : 0;
+	};
+
+	auto emit = [&](uint32_t token) {
+		tokens.push_back(token);
+		if (tokens.size() == BlockTokens) {
+			WriteBlock(bw, tokens, false);
+			tokens.clear();
+		}
+	};
+
+	size_t i = 0;
+	if (!lazy) {
+		while (i < size) {
+			uint32_t dist = 0;
+			uint32_t len = find(i, dist);
+			if (len) {
+				emit(MatchFlag | len << 16 | dist);
+				for (size_t k = 0; k < len; ++k) {
+					insert(i + k);
+				}
+				i += len;
+			} else {
+				emit(in[i]);
+				insert(i);
+				++i;
+			}
+		}
+	} else {
+		// hold each match for one byte and take the next one instead when it is longer
+		uint32_t prevLen = 0, prevDist = 0;
+		bool pending = false;
+
+		while (i < size) {
+			uint32_t dist = 0;
+			uint32_t len = prevLen >= 32 ? 0 : find(i, dist);
+
+			if (pending && prevLen && len <= prevLen) {
+				// match started at i - 1 and i is already searched, insert the rest of it
+				emit(MatchFlag | prevLen << 16 | prevDist);
+				size_t end = i - 1 + prevLen;
+				for (; i < end; ++i) {
+					insert(i);
+				}
+				pending = false;
+				prevLen = 0;
+				continue;
+			}
+
+			if (pending) {
+				emit(in[i - 1]);
+			}
+
+			insert(i);
+			pending = true;
+			prevLen = len;
+			prevDist = dist;
+			++i;
+		}
+
+		if (pending) {
+			if (prevLen) {
+				emit(MatchFlag | prevLen << 16 | prevDist);
+			} else {
+				emit(in[size - 1]);
+			}
+		}
+	}
+
+	WriteBlock(bw, tokens, true);
+	bw.Align();
+
+	// incompressible input, stored blocks cost 5 bytes per 64k
+	if (out.size() > size + 5 * (size / 0xffff + 1)) {
+		return Compress(data, size, 0);
+	}
+	return out;
+}
+
+// Content-Encoding: gzip (RFC 1952)
+inline std::string Gzip(const std::string &data, int level = 6)
+{
+	static const char header[10] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff' };
+
+	std::string out(header, sizeof(header));
+	out += Compress(data.data(), data.size(), level);
+
+	uint32_t trailer[2] = { Crc32(data.data(), data.size()), (uint32_t)data.size() };
+	for (auto v : trailer) {
+		for (int i = 0; i < 4; ++i) {
+			out += (char)((v >> (i * 8)) & 0xff);
+		}
+	}
+	return out;
+}
+
+// Content-Encoding: deflate, which HTTP defines as the zlib format (RFC 1950)
+inline std::string Zlib(const std::string &data, int level = 6)
+{
+	std::string out = "\x78\x9c";
+	out += Compress(data.data(), data.size(), level);
+
+	auto adler = Adler32(data.data(), data.size());
+	for (int i = 3; i >= 0; --i) {
+		out += (char)((adler >> (i * 8)) & 0xff);
+	}
+	return out;
+}
+
+}
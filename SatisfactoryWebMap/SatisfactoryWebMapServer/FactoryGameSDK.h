@@ -1,12 +1,19 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
 #include <string>
 #include <cassert>
 #include <iostream>
 #include <vector>
 
+#ifdef _WIN32
 #include <windows.h>
+#else
+// only the layouts are needed outside the game, e.g. the benchmarks on a captured dump
+#define FORCEINLINE inline
+#define TEXT(x) x
+#endif
 
 #pragma pack(1)
 
@@ -38,7 +45,7 @@ struct Vector3
 	}
 };
 
-std::ostream &operator<<(std::ostream &os, const Vector3 &vec)
+inline std::ostream &operator<<(std::ostream &os, const Vector3 &vec)
 {
 	os << vec.x << "," << vec.y << "," << vec.z;
 	return os;
@@ -56,7 +63,7 @@ struct FRotator
 	}
 };
 
-std::ostream &operator<<(std::ostream &os, const FRotator &rot)
+inline std::ostream &operator<<(std::ostream &os, const FRotator &rot)
 {
 	os << rot.pitch << "," << rot.yaw << "," << rot.roll;
 	return os;
@@ -85,7 +92,7 @@ struct Vector4
 	}
 };
 
-std::ostream &operator<<(std::ostream &os, const Vector4 &vec)
+inline std::ostream &operator<<(std::ostream &os, const Vector4 &vec)
 {
 	os << vec.x << "," << vec.y << "," << vec.z << "," << vec.w;
 	return os;
@@ -229,7 +236,7 @@ struct FName
 
 }; //Size: 0x0008
 
-std::ostream &operator<<(std::ostream &os, const FName &fname)
+inline std::ostream &operator<<(std::ostream &os, const FName &fname)
 {
 	os << fname.ToString();
 	return os;
@@ -389,6 +396,25 @@ struct AActor : public UObjectBase
 
 static_assert(sizeof(AActor) == 0x0330, "sizeof error");
 
+// FGActorRepresentation::mRepresentationType
+enum ERepresentationType : int8_t
+{
+	RT_Default,
+	RT_Beacon,
+	RT_Crate,
+	RT_Hub,
+	RT_Ping,
+	RT_Player,
+	RT_RadarTower,
+	RT_Resource,
+	RT_SpaceElevator,
+	RT_StartingPod,
+	RT_Train,
+	RT_TrainStation,
+	RT_Vehicle,
+	RT_VehicleDockingStation,
+};
+
 struct FGActorRepresentation : public UObjectBase
 {
 	bool mIsLocal; //0x0028
@@ -0,0 +1,359 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <charconv>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "Snapshot.h"
+#include "TrailStore.h"
+#include "RollupStore.h"
+
+// Writes the /api/actors and /api/actors/delta bodies straight into a string, without building
+// a json document first. The output is byte for byte what nlohmann::json::dump() gave for the
+// same data: keys in sorted order, no whitespace, floats widened to double and printed with
+// nlohmann's shortest round-trip formatter.
+class GeoJsonWriter
+{
+public:
+	explicit GeoJsonWriter(std::string &out) : out(out)
+	{}
+
+	template <size_t N>
+	void Raw(const char (&text)[N])
+	{
+		out.append(text, N - 1);
+	}
+
+	void Int(int64_t v)
+	{
+		char buf[24];
+		auto end = std::to_chars(buf, buf + sizeof(buf), v).ptr;
+		out.append(buf, end - buf);
+	}
+
+	void UInt(uint64_t v)
+	{
+		char buf[24];
+		auto end = std::to_chars(buf, buf + sizeof(buf), v).ptr;
+		out.append(buf, end - buf);
+	}
+
+	void Float(float v)
+	{
+		if (!std::isfinite(v)) {
+			Raw("null");
+			return;
+		}
+
+		char buf[64];
+		auto end = nlohmann::detail::to_chars(buf, buf + sizeof(buf), (double)v);
+		out.append(buf, end - buf);
+	}
+
+	void Bool(bool v)
+	{
+		if (v) {
+			Raw("true");
+		} else {
+			Raw("false");
+		}
+	}
+
+	// same escaping as dump() with ensure_ascii off
+	void String(const std::string &s)
+	{
+		static const char hex[] = "0123456789abcdef";
+
+		out += '"';
+		for (unsigned char c : s) {
+			switch (c) {
+			case '"': Raw("\\\""); break;
+			case '\\': Raw("\\\\"); break;
+			case '\b': Raw("\\b"); break;
+			case '\f': Raw("\\f"); break;
+			case '\n': Raw("\\n"); break;
+			case '\r': Raw("\\r"); break;
+			case '\t': Raw("\\t"); break;
+			default:
+				if (c < 0x20) {
+					char escaped[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+					out.append(escaped, sizeof(escaped));
+				} else {
+					out += (char)c;
+				}
+				break;
+			}
+		}
+		out += '"';
+	}
+
+	void Floats(const float *v, size_t n)
+	{
+		out += '[';
+		for (size_t i = 0; i < n; ++i) {
+			if (i) {
+				out += ',';
+			}
+			Float(v[i]);
+		}
+		out += ']';
+	}
+
+	void Ints(const int32_t *v, size_t n)
+	{
+		out += '[';
+		for (size_t i = 0; i < n; ++i) {
+			if (i) {
+				out += ',';
+			}
+			Int(v[i]);
+		}
+		out += ']';
+	}
+
+	void Feature(const ActorState &actor)
+	{
+		Raw("{\"geometry\":{\"coordinates\":");
+		Floats(actor.Location, 3);
+		Raw(",\"type\":\"Point\"},\"properties\":{\"ang\":");
+		Floats(actor.Rotation, 3);
+		Raw(",\"color\":");
+		Ints(actor.Color, 4);
+		Raw(",\"index\":");
+		Int(actor.Index);
+		Raw(",\"type\":");
+		Int(actor.Type);
+		if (actor.HasVelocity) {
+			Raw(",\"vel\":");
+			Floats(actor.Velocity, 3);
+		}
+		Raw("},\"type\":\"Feature\"}");
+	}
+
+	template <typename Actors>
+	void Features(const Actors &actors)
+	{
+		out += '[';
+		bool first = true;
+		for (const auto &actor : actors) {
+			if (!first) {
+				out += ',';
+			}
+			first = false;
+			Feature(Deref(actor));
+		}
+		out += ']';
+	}
+
+	void Error(const std::string &msg)
+	{
+		Raw("{\"msg\":");
+		String(msg);
+		Raw(",\"status\":\"err\"}");
+	}
+
+	// /api/actors
+	void FeatureCollection(const Snapshot &snapshot)
+	{
+		if (!snapshot.Valid) {
+			Error(snapshot.Error);
+			return;
+		}
+
+		Raw("{\"features\":");
+		Features(snapshot.Actors);
+		Raw(",\"status\":\"ok\",\"type\":\"FeatureCollection\"}");
+	}
+
+	// /api/actors?bbox=, only the given actors of snapshot
+	void FeatureCollection(const Snapshot &snapshot, const std::vector<const ActorState *> &actors)
+	{
+		if (!snapshot.Valid) {
+			Error(snapshot.Error);
+			return;
+		}
+
+		Raw("{\"features\":");
+		Features(actors);
+		Raw(",\"status\":\"ok\",\"type\":\"FeatureCollection\"}");
+	}
+
+	// /api/clusters, a cluster of one is written as the actor itself
+	void Clusters(const Snapshot &snapshot, int zoom, const std::vector<const ClusterIndex::Cluster *> &clusters)
+	{
+		if (!snapshot.Valid) {
+			Error(snapshot.Error);
+			return;
+		}
+
+		Raw("{\"features\":[");
+		bool first = true;
+		for (const auto *cluster : clusters) {
+			if (!first) {
+				out += ',';
+			}
+			first = false;
+
+			if (cluster->Count == 1) {
+				Feature(snapshot.Actors[cluster->First]);
+				continue;
+			}
+
+			Raw("{\"geometry\":{\"coordinates\":");
+			Floats(cluster->Location, 3);
+			Raw(",\"type\":\"Point\"},\"properties\":{\"cluster\":true,\"cluster_id\":");
+			UInt(ClusterIndex::ClusterId(zoom, *cluster));
+			Raw(",\"count\":");
+			UInt(cluster->Count);
+			Raw("},\"type\":\"Feature\"}");
+		}
+		Raw("],\"status\":\"ok\",\"type\":\"FeatureCollection\"}");
+	}
+
+	// /api/history, a LineString per trail with the time of every point.
+	// A trail of one point is an actor that has not moved, it is left out.
+	void Trails(const std::vector<TrailStore::Trail> &trails)
+	{
+		Raw("{\"features\":[");
+		bool first = true;
+		for (const auto &trail : trails) {
+			if (trail.Points.size() < 2) {
+				continue;
+			}
+
+			if (!first) {
+				out += ',';
+			}
+			first = false;
+
+			Raw("{\"geometry\":{\"coordinates\":[");
+			for (size_t i = 0; i < trail.Points.size(); ++i) {
+				if (i) {
+					out += ',';
+				}
+				Floats(trail.Points[i].Location, 3);
+			}
+			Raw("],\"type\":\"LineString\"},\"properties\":{\"index\":");
+			Int(trail.Index);
+			Raw(",\"times\":[");
+			for (size_t i = 0; i < trail.Points.size(); ++i) {
+				if (i) {
+					out += ',';
+				}
+				Int(trail.Points[i].Time);
+			}
+			Raw("],\"type\":");
+			Int(trail.Type);
+			Raw("},\"type\":\"Feature\"}");
+		}
+		Raw("],\"status\":\"ok\",\"type\":\"FeatureCollection\"}");
+	}
+
+	// /api/rollups, positions and boxes back in cm like the rest of the map
+	void Rollups(const std::vector<RollupStore::Series> &series)
+	{
+		Raw("{\"features\":[");
+		bool first = true;
+		for (const auto &one : series) {
+			if (one.Buckets.empty()) {
+				continue;
+			}
+
+			if (!first) {
+				out += ',';
+			}
+			first = false;
+
+			// one bucket is where the actor ended up
+			bool line = one.Buckets.size() > 1;
+			Raw("{\"geometry\":{\"coordinates\":");
+			if (line) {
+				out += '[';
+			}
+			for (size_t i = 0; i < one.Buckets.size(); ++i) {
+				if (i) {
+					out += ',';
+				}
+				const auto &last = one.Buckets[i].Last;
+				const int32_t at[3] = { last[0] * 100, last[1] * 100, last[2] * 100 };
+				Ints(at, 3);
+			}
+			if (line) {
+				Raw("],\"type\":\"LineString\"},\"properties\":{\"boxes\":[");
+			} else {
+				Raw(",\"type\":\"Point\"},\"properties\":{\"boxes\":[");
+			}
+			for (size_t i = 0; i < one.Buckets.size(); ++i) {
+				if (i) {
+					out += ',';
+				}
+				const auto &box = one.Buckets[i].Box;
+				const int32_t area[4] = { box[0] * 100, box[1] * 100, box[2] * 100, box[3] * 100 };
+				Ints(area, 4);
+			}
+			Raw("],\"distances\":[");
+			for (size_t i = 0; i < one.Buckets.size(); ++i) {
+				if (i) {
+					out += ',';
+				}
+				Float(one.Buckets[i].Distance);
+			}
+			Raw("],\"index\":");
+			Int(one.Index);
+			Raw(",\"resolution\":");
+			Int(RollupStore::Levels[one.Tier].Resolution);
+			Raw(",\"times\":[");
+			for (size_t i = 0; i < one.Buckets.size(); ++i) {
+				if (i) {
+					out += ',';
+				}
+				Int(one.Buckets[i].Slot * RollupStore::Levels[one.Tier].Resolution);
+			}
+			Raw("],\"type\":");
+			Int(one.Type);
+			Raw("},\"type\":\"Feature\"}");
+		}
+		Raw("],\"status\":\"ok\",\"type\":\"FeatureCollection\"}");
+	}
+
+	// /api/actors/delta, a full snapshot when base is nullptr
+	void Delta(const Snapshot *base, const Snapshot &snapshot)
+	{
+		Raw("{\"added\":");
+		if (base == nullptr) {
+			Features(snapshot.Actors);
+			Raw(",\"changed\":[],\"full\":true,\"removed\":[]");
+		} else {
+			SnapshotDelta delta;
+			DiffSnapshots(*base, snapshot, delta);
+
+			Features(delta.Added);
+			Raw(",\"changed\":");
+			Features(delta.Changed);
+			Raw(",\"full\":false,\"removed\":");
+			Ints(delta.Removed.data(), delta.Removed.size());
+		}
+
+		Raw(",\"seq\":");
+		UInt(snapshot.Seq);
+		Raw(",\"since\":");
+		UInt(base ? base->Seq : 0);
+		Raw(",\"status\":\"ok\"}");
+	}
+
+private:
+	static const ActorState &Deref(const ActorState &actor)
+	{
+		return actor;
+	}
+
+	static const ActorState &Deref(const ActorState *actor)
+	{
+		return *actor;
+	}
+
+	std::string &out;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// FNV-1a, used for content hashes (ETags, change detection)
+constexpr uint64_t FNV64Offset = 0xcbf29ce484222325ull;
+constexpr uint64_t FNV64Prime = 0x100000001b3ull;
+
+inline uint64_t Fnv1a64(const void *data, size_t len, uint64_t hash = FNV64Offset)
+{
+	auto p = (const uint8_t *)data;
+	for (size_t i = 0; i < len; ++i) {
+		hash ^= p[i];
+		hash *= FNV64Prime;
+	}
+	return hash;
+}
+
+inline uint64_t Fnv1a64(const std::string &s, uint64_t hash = FNV64Offset)
+{
+	return Fnv1a64(s.data(), s.size(), hash);
+}
+
+inline std::string HashToHex(uint64_t hash)
+{
+	static const char digits[] = "0123456789abcdef";
+
+	std::string out(16, '0');
+	for (int i = 15; i >= 0; --i) {
+		out[i] = digits[hash & 0xf];
+		hash >>= 4;
+	}
+	return out;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <httplib.h>
+
+#include <string>
+#include <cstdlib>
+
+#include "Deflate.h"
+
+// Sets ETag on the response, and turns it into a 304 when the client already has this version.
+// Returns true when the caller should not send a body.
+inline bool NotModified(const httplib::Request &req, httplib::Response &res, const std::string &etag)
+{
+	res.set_header("ETag", etag);
+
+	if (!req.has_header("If-None-Match")) {
+		return false;
+	}
+
+	const auto &match = req.get_header_value("If-None-Match");
+	if (match != "*" && match.find(etag) == std::string::npos) {
+		return false;
+	}
+
+	res.status = 304;
+	return true;
+}
+
+// Best Content-Encoding we can produce for this request: "gzip", "deflate" or "" for identity
+inline std::string AcceptedEncoding(const httplib::Request &req)
+{
+	if (!req.has_header("Accept-Encoding")) {
+		return "";
+	}
+
+	const auto &header = req.get_header_value("Accept-Encoding");
+
+	// -1 not mentioned, 0 refused, 1 accepted
+	int gzip = -1, deflate = -1, any = -1;
+	size_t pos = 0;
+	while (pos < header.size()) {
+		auto end = header.find(',', pos);
+		if (end == std::string::npos) {
+			end = header.size();
+		}
+
+		auto item = header.substr(pos, end - pos);
+		pos = end + 1;
+
+		// "gzip;q=0" means not acceptable
+		auto semicolon = item.find(';');
+		auto name = item.substr(0, semicolon);
+		name.erase(0, name.find_first_not_of(' '));
+		name.erase(name.find_last_not_of(' ') + 1);
+
+		bool refused = false;
+		if (semicolon != std::string::npos) {
+			auto q = item.find("q=", semicolon);
+			refused = q != std::string::npos && std::strtod(item.c_str() + q + 2, nullptr) <= 0.0;
+		}
+
+		if (name == "gzip") {
+			gzip = !refused;
+		} else if (name == "deflate") {
+			deflate = !refused;
+		} else if (name == "*") {
+			any = !refused;
+		}
+	}
+
+	if (gzip == 1 || (gzip == -1 && any == 1)) {
+		return "gzip";
+	}
+	if (deflate == 1 || (deflate == -1 && any == 1)) {
+		return "deflate";
+	}
+	return "";
+}
+
+inline std::string EncodeContent(const std::string &encoding, const std::string &body, int level)
+{
+	return encoding == "gzip" ? deflate::Gzip(body, level) : deflate::Zlib(body, level);
+}
@@ -0,0 +1,547 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Where game memory is read from. Game pointers are only ever used as addresses and read through
+// one of these, so the same code runs inside the game (ProcessMemory) or on a captured image of
+// the memory it touched (MemoryDump, recorded with RecordingMemory).
+class MemorySource
+{
+public:
+	struct Range
+	{
+		const void *Address;
+		void *Out;
+		size_t Size;
+	};
+
+	virtual ~MemorySource() = default;
+
+	// Copies size bytes at address into out, false when any of it cannot be read
+	virtual bool Read(const void *address, void *out, size_t size) const = 0;
+
+	// Reads every range, the ones that fail are zero filled. False when any failed.
+	virtual bool ReadBatch(const Range *ranges, size_t count) const
+	{
+		bool ok = true;
+		for (size_t i = 0; i < count; ++i) {
+			if (!Read(ranges[i].Address, ranges[i].Out, ranges[i].Size)) {
+				std::memset(ranges[i].Out, 0, ranges[i].Size);
+				ok = false;
+			}
+		}
+		return ok;
+	}
+
+	// NUL terminated string of at most maxLen chars, never reads past the terminator's block
+	virtual bool ReadString(const char *address, size_t maxLen, std::string &out) const
+	{
+		out.clear();
+
+		char piece[Granularity];
+		while (out.size() < maxLen) {
+			auto offset = (size_t)((uintptr_t)address % Granularity);
+			auto n = (std::min)(Granularity - offset, maxLen - out.size());
+			if (!Read(address, piece, n)) {
+				return false;
+			}
+
+			auto len = strnlen(piece, n);
+			out.append(piece, len);
+			if (len < n) {
+				return true;
+			}
+			address += n;
+		}
+		return true;
+	}
+
+	template <typename T>
+	bool Read(const T *address, T &out) const
+	{
+		return Read((const void *)address, &out, sizeof(T));
+	}
+
+	// Value at address, zero when it cannot be read
+	template <typename T>
+	T Get(const T *address) const
+	{
+		T out{};
+		Read(address, out);
+		return out;
+	}
+
+	// piece size of the default ReadString
+	static constexpr size_t Granularity = 64;
+};
+
+// This process, for when the server runs inside the game
+class ProcessMemory : public MemorySource
+{
+public:
+	using MemorySource::Read;
+
+	bool Read(const void *address, void *out, size_t size) const override
+	{
+		if (address == nullptr) {
+			return false;
+		}
+
+		std::memcpy(out, address, size);
+		return true;
+	}
+
+	bool ReadString(const char *address, size_t maxLen, std::string &out) const override
+	{
+		if (address == nullptr) {
+			return false;
+		}
+
+		out.assign(address, strnlen(address, maxLen));
+		return true;
+	}
+};
+
+// Read-only view of a whole file
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	~MappedFile()
+	{
+		Close();
+	}
+
+	bool Open(const std::string &path)
+	{
+		Close();
+
+#ifdef _WIN32
+		// the snapshot log maps segments that are still being appended to
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+			Close();
+			return false;
+		}
+
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) {
+			Close();
+			return false;
+		}
+
+		data = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		size = (size_t)fileSize.QuadPart;
+#else
+		fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			Close();
+			return false;
+		}
+
+		void *view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		data = view == MAP_FAILED ? nullptr : (const char *)view;
+		size = (size_t)st.st_size;
+#endif
+
+		if (data == nullptr) {
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void Close()
+	{
+#ifdef _WIN32
+		if (data != nullptr) {
+			UnmapViewOfFile(data);
+		}
+		if (mapping != nullptr) {
+			CloseHandle(mapping);
+		}
+		if (file != INVALID_HANDLE_VALUE) {
+			CloseHandle(file);
+		}
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (data != nullptr) {
+			munmap((void *)data, size);
+		}
+		if (fd >= 0) {
+			close(fd);
+		}
+		fd = -1;
+#endif
+		data = nullptr;
+		size = 0;
+	}
+
+	const char *Data() const
+	{
+		return data;
+	}
+
+	size_t Size() const
+	{
+		return size;
+	}
+
+private:
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+	const char *data = nullptr;
+	size_t size = 0;
+};
+
+// A captured image of game memory: named root addresses plus the pages that were read, at
+// their original addresses. The file is mapped, not loaded, so only the pages a replay
+// touches are ever read from disk.
+//
+// File layout, little endian:
+//   header    "SWMD" u32 version, u32 root count, u32 region count
+//   roots     per root: char name[24], u64 address
+//   regions   per region, sorted by address: u64 address, u64 size, u64 file offset
+//   data      every region at a PageSize aligned file offset
+class MemoryDump : public MemorySource
+{
+public:
+	static constexpr uint32_t Version = 2;
+	static constexpr size_t PageSize = 4096;
+
+	using MemorySource::Read;
+
+	bool Load(const std::string &path)
+	{
+		roots = nullptr;
+		regions = nullptr;
+		rootCount = regionCount = 0;
+
+		if (!file.Open(path) || file.Size() < sizeof(Header)) {
+			return false;
+		}
+
+		auto header = (const Header *)file.Data();
+		if (std::memcmp(header->Magic, "SWMD", 4) || header->Version != Version) {
+			return false;
+		}
+
+		size_t tables = sizeof(Header) + header->RootCount * sizeof(RootRecord) + header->RegionCount * sizeof(RegionRecord);
+		if (tables > file.Size()) {
+			return false;
+		}
+
+		roots = (const RootRecord *)(file.Data() + sizeof(Header));
+		regions = (const RegionRecord *)(roots + header->RootCount);
+
+		for (uint32_t i = 0; i < header->RegionCount; ++i) {
+			if (regions[i].Offset > file.Size() || regions[i].Size > file.Size() - regions[i].Offset) {
+				return false;
+			}
+		}
+
+		rootCount = header->RootCount;
+		regionCount = header->RegionCount;
+		return true;
+	}
+
+	// Writes the ranges of source as a dump, ranges sorted and not overlapping
+	static bool Save(const std::string &path, const std::map<std::string, uint64_t> &roots,
+		const std::vector<std::pair<uint64_t, uint64_t>> &ranges, const MemorySource &source)
+	{
+		std::ofstream ofs(path, std::ios::binary);
+		if (!ofs) {
+			return false;
+		}
+
+		Header header{ { 'S', 'W', 'M', 'D' }, Version, (uint32_t)roots.size(), (uint32_t)ranges.size() };
+		ofs.write((const char *)&header, sizeof(header));
+
+		for (const auto &it : roots) {
+			RootRecord root{};
+			std::memcpy(root.Name, it.first.data(), (std::min)(it.first.size(), sizeof(root.Name) - 1));
+			root.Address = it.second;
+			ofs.write((const char *)&root, sizeof(root));
+		}
+
+		uint64_t offset = sizeof(Header) + roots.size() * sizeof(RootRecord) + ranges.size() * sizeof(RegionRecord);
+		for (const auto &range : ranges) {
+			offset = (offset + PageSize - 1) / PageSize * PageSize;
+
+			RegionRecord region{ range.first, range.second - range.first, offset };
+			ofs.write((const char *)&region, sizeof(region));
+			offset += region.Size;
+		}
+
+		std::vector<char> page(PageSize);
+		for (const auto &range : ranges) {
+			auto pad = (PageSize - (uint64_t)ofs.tellp() % PageSize) % PageSize;
+			ofs.write(page.data(), pad);
+
+			// pages the source cannot read are saved as zeros
+			for (auto address = range.first; address < range.second; address += PageSize) {
+				auto n = (size_t)(std::min)((uint64_t)PageSize, range.second - address);
+				if (!source.Read((const void *)(uintptr_t)address, page.data(), n)) {
+					std::memset(page.data(), 0, n);
+				}
+				ofs.write(page.data(), n);
+			}
+		}
+
+		return (bool)ofs;
+	}
+
+	// Address saved under name, nullptr when there is none
+	template <typename T>
+	const T *Root(const std::string &name) const
+	{
+		for (uint32_t i = 0; i < rootCount; ++i) {
+			if (strncmp(roots[i].Name, name.c_str(), sizeof(roots[i].Name)) == 0) {
+				return (const T *)(uintptr_t)roots[i].Address;
+			}
+		}
+		return nullptr;
+	}
+
+	size_t Bytes() const
+	{
+		size_t total = 0;
+		for (uint32_t i = 0; i < regionCount; ++i) {
+			total += (size_t)regions[i].Size;
+		}
+		return total;
+	}
+
+	bool Read(const void *address, void *out, size_t size) const override
+	{
+		size_t available;
+		auto data = Find(address, available);
+		if (data == nullptr || size > available) {
+			return false;
+		}
+
+		std::memcpy(out, data, size);
+		return true;
+	}
+
+	bool ReadString(const char *address, size_t maxLen, std::string &out) const override
+	{
+		size_t available;
+		auto data = Find(address, available);
+		if (data == nullptr) {
+			return false;
+		}
+
+		auto len = strnlen(data, (std::min)(available, maxLen));
+		if (len == available && len < maxLen) {
+			return false;
+		}
+
+		out.assign(data, len);
+		return true;
+	}
+
+private:
+#pragma pack(push, 1)
+	struct Header
+	{
+		char Magic[4];
+		uint32_t Version;
+		uint32_t RootCount;
+		uint32_t RegionCount;
+	};
+
+	struct RootRecord
+	{
+		char Name[24];
+		uint64_t Address;
+	};
+
+	struct RegionRecord
+	{
+		uint64_t Address;
+		uint64_t Size;
+		uint64_t Offset;
+	};
+#pragma pack(pop)
+
+	// mapped bytes at address and how many follow it in the same region
+	const char *Find(const void *address, size_t &available) const
+	{
+		auto begin = (uint64_t)(uintptr_t)address;
+
+		auto it = std::upper_bound(regions, regions + regionCount, begin, [](uint64_t a, const RegionRecord &region) {
+			return a < region.Address;
+		});
+		if (it == regions) {
+			return nullptr;
+		}
+		--it;
+
+		auto offset = begin - it->Address;
+		if (offset >= it->Size) {
+			return nullptr;
+		}
+
+		available = (size_t)(it->Size - offset);
+		return file.Data() + it->Offset + offset;
+	}
+
+	MappedFile file;
+	const RootRecord *roots = nullptr;
+	const RegionRecord *regions = nullptr;
+	uint32_t rootCount = 0;
+	uint32_t regionCount = 0;
+};
+
+// Passes reads through to another source and keeps a copy of every page they touched,
+// Save() then writes those copies as a MemoryDump. The bytes a read returned are the bytes
+// saved, even when the game has changed them since, so a replay sees what the walk saw.
+class RecordingMemory : public MemorySource
+{
+public:
+	using MemorySource::Read;
+
+	explicit RecordingMemory(const MemorySource &inner) : inner(inner)
+	{}
+
+	bool Read(const void *address, void *out, size_t size) const override
+	{
+		if (!inner.Read(address, out, size)) {
+			return false;
+		}
+
+		Record(address, out, size);
+		return true;
+	}
+
+	bool ReadString(const char *address, size_t maxLen, std::string &out) const override
+	{
+		if (!inner.ReadString(address, maxLen, out)) {
+			return false;
+		}
+
+		// with the terminator, unless the string was cut at maxLen
+		Record(address, out.c_str(), out.size() < maxLen ? out.size() + 1 : out.size());
+		return true;
+	}
+
+	// Whole pages are saved, a page that was partly read is mapped in full
+	bool Save(const std::string &path, const std::map<std::string, uint64_t> &roots) const
+	{
+		std::lock_guard<std::mutex> _(lock);
+
+		// neighbouring pages become one region
+		std::vector<std::pair<uint64_t, uint64_t>> ranges;
+		for (const auto &it : pages) {
+			if (!ranges.empty() && ranges.back().second == it.first) {
+				ranges.back().second += MemoryDump::PageSize;
+			} else {
+				ranges.emplace_back(it.first, it.first + MemoryDump::PageSize);
+			}
+		}
+
+		return MemoryDump::Save(path, roots, ranges, Recorded{ pages });
+	}
+
+private:
+	struct Page
+	{
+		char Bytes[MemoryDump::PageSize];
+		std::vector<bool> Seen = std::vector<bool>(MemoryDump::PageSize);
+	};
+
+	using PageMap = std::map<uint64_t, std::unique_ptr<Page>>;
+
+	// the page copies as a source for MemoryDump::Save, which reads one page at a time
+	struct Recorded : MemorySource
+	{
+		const PageMap &pages;
+
+		explicit Recorded(const PageMap &pages) : pages(pages)
+		{}
+
+		bool Read(const void *address, void *out, size_t size) const override
+		{
+			auto begin = (uint64_t)(uintptr_t)address;
+			auto it = pages.find(begin / MemoryDump::PageSize * MemoryDump::PageSize);
+			if (it == pages.end() || begin - it->first + size > MemoryDump::PageSize) {
+				return false;
+			}
+
+			std::memcpy(out, it->second->Bytes + (begin - it->first), size);
+			return true;
+		}
+	};
+
+	// Copies the bytes a read returned into their pages. A page is filled from inner when it is
+	// first touched, for the parts the walk never reads; bytes already read once keep the value
+	// they had then, the one the walk acted on.
+	void Record(const void *address, const void *data, size_t size) const
+	{
+		auto begin = (uint64_t)(uintptr_t)address;
+		auto end = begin + size;
+		auto bytes = (const char *)data;
+
+		std::lock_guard<std::mutex> _(lock);
+		for (auto base = begin / MemoryDump::PageSize * MemoryDump::PageSize; base < end; base += MemoryDump::PageSize) {
+			auto &page = pages[base];
+			if (!page) {
+				page = std::make_unique<Page>();
+				if (!inner.Read((const void *)(uintptr_t)base, page->Bytes, MemoryDump::PageSize)) {
+					std::memset(page->Bytes, 0, MemoryDump::PageSize);
+				}
+			}
+
+			auto from = (std::max)(begin, base), to = (std::min)(end, base + MemoryDump::PageSize);
+			for (auto a = from; a < to; ++a) {
+				if (!page->Seen[a - base]) {
+					page->Seen[a - base] = true;
+					page->Bytes[a - base] = bytes[a - begin];
+				}
+			}
+		}
+	}
+
+	const MemorySource &inner;
+
+	mutable std::mutex lock;
+	mutable PageMap pages;
+};
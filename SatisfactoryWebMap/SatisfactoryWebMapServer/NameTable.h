@@ -0,0 +1,264 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "FactoryGameSDK.h"
+#include "Hash.h"
+#include "MemorySource.h"
+
+// Local copy of the game's name table (Names_0), read through a MemorySource.
+//
+// Names are copied once into a few large blocks and never move, so Get() hands out string_views
+// without touching game memory or allocating. Find() goes the other way through an open addressing
+// hash of the same views. The game only ever appends names, Refresh() copies the new ones.
+class NameTable
+{
+public:
+	static constexpr int32_t ElementsPerChunk = TNameEntryArray::ElementsPerChunk;
+	static constexpr int32_t ChunkTableSize = TNameEntryArray::ChunkTableSize;
+
+	// what FNameEntry gives for names we do not copy
+	static constexpr std::string_view WideName = "**WIDESTR**";
+	static constexpr std::string_view InvalidName = "*INVALID*";
+
+	explicit NameTable(const MemorySource &memory) : memory(memory)
+	{}
+
+	NameTable(const NameTable &) = delete;
+	NameTable &operator=(const NameTable &) = delete;
+
+	// Copies names added since the last call, returns how many there are now
+	int32_t Refresh()
+	{
+		std::lock_guard<std::mutex> _(writeLock);
+
+		if (Names_0 == nullptr) {
+			return count.load();
+		}
+
+		// the chunk table, NumElements and NumChunks in one read
+		TNameEntryArray table;
+		if (!memory.Read(Names_0, table)) {
+			return count.load();
+		}
+
+		int32_t num = (std::min)(table.NumElements, (int32_t)TNameEntryArray::MaxTotalElements);
+		int32_t index = count.load(std::memory_order_relaxed);
+		if (index >= num) {
+			return index;
+		}
+
+		std::unique_lock<std::shared_mutex> lookupLock(hashLock);
+
+		std::vector<const FNameEntry *> entries;
+		std::string text;
+
+		while (index < num) {
+			int32_t chunk = index / ElementsPerChunk;
+			if (chunk >= table.NumChunks) {
+				break;
+			}
+
+			// entry pointers of the rest of this chunk
+			int32_t within = index % ElementsPerChunk;
+			entries.resize((std::min)(ElementsPerChunk - within, num - index));
+			if (!memory.Read(table.Chunks[chunk] + within, entries.data(), entries.size() * sizeof(FNameEntry *))) {
+				break;
+			}
+
+			if (!chunks[chunk]) {
+				chunks[chunk].reset(new std::string_view[ElementsPerChunk]);
+			}
+
+			size_t copied = 0;
+			for (auto entry : entries) {
+				// the game fills the slot after bumping NumElements, pick it up next time
+				int32_t flags;
+				if (entry == nullptr || !memory.Read(&entry->Index, flags)) {
+					break;
+				}
+
+				std::string_view name;
+				if (flags & NAME_WIDE_MASK) {
+					name = WideName;
+				} else {
+					if (!memory.ReadString(entry->Name, sizeof(entry->Name), text)) {
+						break;
+					}
+					name = Store(text.data(), text.size());
+					Insert(name, index);
+				}
+
+				chunks[chunk][within++] = name;
+				++index;
+				++copied;
+			}
+
+			if (copied < entries.size()) {
+				break;
+			}
+		}
+
+		count.store(index, std::memory_order_release);
+		return index;
+	}
+
+	int32_t Size() const
+	{
+		return count.load(std::memory_order_acquire);
+	}
+
+	// Name of a ComparisonIndex, empty when there is no such name
+	std::string_view Get(int32_t index)
+	{
+		if (index < 0) {
+			return {};
+		}
+
+		if (index >= Size() && index >= Refresh()) {
+			return {};
+		}
+
+		return chunks[index / ElementsPerChunk][index % ElementsPerChunk];
+	}
+
+	// ComparisonIndex of a name, -1 when the game does not know it. Case sensitive.
+	int32_t Find(std::string_view name)
+	{
+		auto index = Lookup(name);
+		if (index < 0 && Size() < LiveSize()) {
+			Refresh();
+			index = Lookup(name);
+		}
+		return index;
+	}
+
+	// Appends what FName::ToString() gives, "Foo_3" for numbered names
+	void Append(std::string &out, const FName &name)
+	{
+		auto text = Get(name.ComparisonIndex);
+		if (text.empty()) {
+			out += InvalidName;
+			return;
+		}
+
+		out += text;
+		if (name.Number != NAME_NO_NUMBER_INTERNAL) {
+			out += '_';
+			out += std::to_string(NAME_INTERNAL_TO_EXTERNAL(name.Number));
+		}
+	}
+
+	std::string ToString(const FName &name)
+	{
+		std::string out;
+		Append(out, name);
+		return out;
+	}
+
+private:
+	static constexpr size_t BlockSize = 256 * 1024;
+
+	int32_t LiveSize() const
+	{
+		return Names_0 ? memory.Get(&Names_0->NumElements) : 0;
+	}
+
+	std::string_view Store(const char *text, size_t len)
+	{
+		if (blockUsed + len > blockSize) {
+			blockSize = (std::max)(BlockSize, len);
+			blocks.emplace_back(new char[blockSize]);
+			blockUsed = 0;
+		}
+
+		char *dst = blocks.back().get() + blockUsed;
+		std::memcpy(dst, text, len);
+		blockUsed += len;
+		return std::string_view(dst, len);
+	}
+
+	static size_t HashOf(std::string_view name)
+	{
+		return (size_t)Fnv1a64(name.data(), name.size());
+	}
+
+	// hashLock held exclusively
+	void Insert(std::string_view name, int32_t index)
+	{
+		if ((entries + 1) * 2 > slots.size()) {
+			std::vector<int32_t> old(std::max<size_t>(slots.size() * 2, 1024), -1);
+			old.swap(slots);
+			entries = 0;
+
+			for (auto i : old) {
+				if (i >= 0) {
+					Place(View(i), i);
+				}
+			}
+		}
+
+		Place(name, index);
+	}
+
+	void Place(std::string_view name, int32_t index)
+	{
+		size_t mask = slots.size() - 1;
+		for (size_t slot = HashOf(name) & mask;; slot = (slot + 1) & mask) {
+			if (slots[slot] < 0) {
+				slots[slot] = index;
+				++entries;
+				return;
+			}
+
+			// duplicates keep the first index, like the game's own lookup
+			if (View(slots[slot]) == name) {
+				return;
+			}
+		}
+	}
+
+	int32_t Lookup(std::string_view name) const
+	{
+		std::shared_lock<std::shared_mutex> _(hashLock);
+		if (slots.empty()) {
+			return -1;
+		}
+
+		size_t mask = slots.size() - 1;
+		for (size_t slot = HashOf(name) & mask; slots[slot] >= 0; slot = (slot + 1) & mask) {
+			if (View(slots[slot]) == name) {
+				return slots[slot];
+			}
+		}
+		return -1;
+	}
+
+	std::string_view View(int32_t index) const
+	{
+		return chunks[index / ElementsPerChunk][index % ElementsPerChunk];
+	}
+
+	const MemorySource &memory;
+
+	// written only under writeLock, count is published last
+	std::unique_ptr<std::string_view[]> chunks[ChunkTableSize];
+	std::atomic<int32_t> count = 0;
+
+	std::mutex writeLock;
+	std::vector<std::unique_ptr<char[]>> blocks;
+	size_t blockSize = 0;
+	size_t blockUsed = 0;
+
+	mutable std::shared_mutex hashLock;
+	std::vector<int32_t> slots;
+	size_t entries = 0;
+};
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "FactoryGameSDK.h"
+#include "MemorySource.h"
+#include "NameTable.h"
+#include "WorkerPool.h"
+
+// Object slots of GUObjectArray grouped by class and by name.
+//
+// Refresh() walks the item array only, comparing each slot's Object and SerialNumber with what
+// it saw last time, and only reads the objects of slots that changed. A slot reused by
+// the garbage collector gets a new object pointer or serial number, so stale entries drop out.
+class ObjectIndex
+{
+public:
+	struct ClassCount
+	{
+		std::string Name;
+		int32_t Count;
+	};
+
+	ObjectIndex(const MemorySource &memory, NameTable &names, WorkerPool &pool) : memory(memory), names(names), pool(pool)
+	{}
+
+	// Picks up objects created or destroyed since the last call, unless that was less than maxAge ago
+	void Refresh(std::chrono::milliseconds maxAge = std::chrono::milliseconds(0))
+	{
+		std::lock_guard<std::mutex> _(refreshLock);
+		if (GUObjectArray == nullptr) {
+			return;
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		if (refreshed && now - lastRefresh < maxAge) {
+			return;
+		}
+
+		FChunkedFixedUObjectArray objects;
+		if (!memory.Read(&GUObjectArray->ObjObjects, objects)) {
+			return;
+		}
+
+		const int32_t num = objects.NumElements;
+		const int chunks = (num + PerChunk - 1) / PerChunk;
+
+		// only this function writes slots, reading it here without the lock is fine
+		std::vector<std::vector<Change>> changes(chunks);
+		pool.ParallelFor(chunks, [&](int chunk) {
+			int32_t begin = chunk * PerChunk, end = (std::min)(begin + PerChunk, num);
+
+			thread_local std::vector<FUObjectItem> items;
+			items.resize(end - begin);
+
+			auto chunkItems = memory.Get(objects.Objects + chunk);
+			if (chunkItems == nullptr || !memory.Read(chunkItems, items.data(), items.size() * sizeof(FUObjectItem))) {
+				return;
+			}
+
+			for (int32_t i = begin; i < end; ++i) {
+				const auto &item = items[i - begin];
+				const Slot *cached = i < (int32_t)slots.size() ? &slots[i] : nullptr;
+
+				if (cached ? cached->Object == item.Object && cached->Serial == item.SerialNumber : item.Object == nullptr) {
+					continue;
+				}
+
+				Change change{ i, item.Object, item.SerialNumber };
+				UObjectBase header;
+				if (item.Object != nullptr && memory.Read(item.Object, header)) {
+					change.Class = (const UObjectBase *)header.ClassPrivate;
+					change.Name = header.NamePrivate;
+				}
+				changes[chunk].push_back(change);
+			}
+		});
+
+		std::unique_lock<std::shared_mutex> write(lock);
+		if ((int32_t)slots.size() < num) {
+			slots.resize(num);
+		}
+
+		for (const auto &chunk : changes) {
+			for (const auto &change : chunk) {
+				Remove(change.Index);
+				Insert(change);
+			}
+		}
+
+		refreshed = true;
+		lastRefresh = now;
+	}
+
+	// Live objects seen by the last Refresh()
+	int32_t Size() const
+	{
+		std::shared_lock<std::shared_mutex> _(lock);
+		return live;
+	}
+
+	// Object count per class name, largest first
+	std::vector<ClassCount> ClassHistogram() const
+	{
+		std::unordered_map<std::string, int32_t> counts;
+		{
+			std::shared_lock<std::shared_mutex> _(lock);
+			for (const auto &it : byClass) {
+				if (!it.second.Slots.empty()) {
+					counts[it.second.Name] += (int32_t)it.second.Slots.size();
+				}
+			}
+		}
+
+		std::vector<ClassCount> histogram;
+		histogram.reserve(counts.size());
+		for (auto &it : counts) {
+			histogram.push_back({ it.first, it.second });
+		}
+
+		std::sort(histogram.begin(), histogram.end(), [](const ClassCount &a, const ClassCount &b) {
+			return a.Count != b.Count ? a.Count > b.Count : a.Name < b.Name;
+		});
+		return histogram;
+	}
+
+	// Slots of objects whose class is named className, ascending
+	std::vector<int32_t> FindByClass(const std::string &className) const
+	{
+		std::vector<int32_t> found;
+		{
+			std::shared_lock<std::shared_mutex> _(lock);
+			for (const auto &it : byClass) {
+				if (it.second.Name == className) {
+					found.insert(found.end(), it.second.Slots.begin(), it.second.Slots.end());
+				}
+			}
+		}
+
+		std::sort(found.begin(), found.end());
+		return found;
+	}
+
+	// Slots of objects named name, ascending
+	std::vector<int32_t> FindByName(const FName &name) const
+	{
+		std::vector<int32_t> found;
+		{
+			std::shared_lock<std::shared_mutex> _(lock);
+			auto it = byName.find(name.ComparisonIndex);
+			if (it != byName.end()) {
+				for (auto i : it->second) {
+					if (slots[i].Name.Number == name.Number) {
+						found.push_back(i);
+					}
+				}
+			}
+		}
+
+		std::sort(found.begin(), found.end());
+		return found;
+	}
+
+	// Name the object in a slot had when it was indexed
+	FName NameOf(int32_t index) const
+	{
+		std::shared_lock<std::shared_mutex> _(lock);
+		if (index < 0 || index >= (int32_t)slots.size() || slots[index].Object == nullptr) {
+			return { -1, NAME_NO_NUMBER_INTERNAL };
+		}
+		return slots[index].Name;
+	}
+
+private:
+	// one task per GUObjectArray chunk
+	static constexpr int32_t PerChunk = FChunkedFixedUObjectArray::NumElementsPerChunk;
+
+	struct Slot
+	{
+		const UObjectBase *Object = nullptr;
+		int32_t Serial = 0;
+		const UObjectBase *Class = nullptr;
+		FName Name{ -1, NAME_NO_NUMBER_INTERNAL };
+
+		// where this slot sits in its byClass and byName lists
+		int32_t ClassPos = -1;
+		int32_t NamePos = -1;
+	};
+
+	struct Change
+	{
+		int32_t Index;
+		const UObjectBase *Object;
+		int32_t Serial;
+		const UObjectBase *Class = nullptr;
+		FName Name{ -1, NAME_NO_NUMBER_INTERNAL };
+	};
+
+	struct ClassEntry
+	{
+		std::string Name;
+		std::vector<int32_t> Slots;
+	};
+
+	// lock held exclusively
+	void Insert(const Change &change)
+	{
+		auto &slot = slots[change.Index];
+		slot.Object = change.Object;
+		slot.Serial = change.Serial;
+		slot.Class = change.Class;
+		slot.Name = change.Name;
+
+		if (slot.Object == nullptr) {
+			return;
+		}
+		++live;
+
+		auto it = byClass.find(slot.Class);
+		if (it == byClass.end()) {
+			it = byClass.emplace(slot.Class, ClassEntry{ slot.Class ? names.ToString(memory.Get(&slot.Class->NamePrivate)) : std::string(NameTable::InvalidName), {} }).first;
+		}
+		slot.ClassPos = (int32_t)it->second.Slots.size();
+		it->second.Slots.push_back(change.Index);
+
+		auto &named = byName[slot.Name.ComparisonIndex];
+		slot.NamePos = (int32_t)named.size();
+		named.push_back(change.Index);
+	}
+
+	// lock held exclusively, swaps the last entry into the hole
+	void Remove(int32_t index)
+	{
+		auto &slot = slots[index];
+		if (slot.Object == nullptr) {
+			return;
+		}
+		--live;
+
+		// emptied lists stay, the same class or name usually comes back
+		auto &classSlots = byClass[slot.Class].Slots;
+		slots[classSlots.back()].ClassPos = slot.ClassPos;
+		classSlots[slot.ClassPos] = classSlots.back();
+		classSlots.pop_back();
+
+		auto &named = byName[slot.Name.ComparisonIndex];
+		slots[named.back()].NamePos = slot.NamePos;
+		named[slot.NamePos] = named.back();
+		named.pop_back();
+
+		slot = Slot{};
+	}
+
+	const MemorySource &memory;
+	NameTable &names;
+	WorkerPool &pool;
+
+	std::mutex refreshLock;
+	bool refreshed = false;
+	std::chrono::steady_clock::time_point lastRefresh;
+
+	mutable std::shared_mutex lock;
+	std::vector<Slot> slots;
+	std::unordered_map<const UObjectBase *, ClassEntry> byClass;
+	std::unordered_map<int32_t, std::vector<int32_t>> byName;
+	int32_t live = 0;
+};
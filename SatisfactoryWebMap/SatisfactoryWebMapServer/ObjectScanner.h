@@ -0,0 +1,296 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define OBJECT_SCANNER_SSE2 1
+#endif
+
+#include "FactoryGameSDK.h"
+#include "MemorySource.h"
+#include "NameTable.h"
+#include "WorkerPool.h"
+
+// Parallel scans over GUObjectArray.
+//
+// Name lookups resolve the string to a ComparisonIndex with the NameTable and then only
+// compare integers: each block of slots has its ComparisonIndex values copied into a small
+// buffer, which is compared four at a time with SSE2. Blocks are spread over a WorkerPool.
+class ObjectScanner
+{
+public:
+	// slots handed to one worker at a time, a quarter of a GUObjectArray chunk
+	static constexpr int32_t SlotsPerTask = FChunkedFixedUObjectArray::NumElementsPerChunk / 4;
+
+	ObjectScanner(const MemorySource &memory, NameTable &names, WorkerPool &pool) : memory(memory), names(names), pool(pool)
+	{}
+
+	// An FName as stored in memory, "Foo_3" is { index of "Foo", 4 }
+	struct NameKey
+	{
+		int32_t ComparisonIndex;
+		int32_t Number;
+	};
+
+	// Every way name could be stored, empty when the name table does not have it
+	std::vector<NameKey> ResolveName(const std::string &name)
+	{
+		std::vector<NameKey> keys;
+
+		auto plain = names.Find(name);
+		if (plain >= 0) {
+			keys.push_back({ plain, NAME_NO_NUMBER_INTERNAL });
+		}
+
+		// trailing _<number> without leading zeros is kept as the number part
+		auto underscore = name.rfind('_');
+		if (underscore != std::string::npos && underscore + 1 < name.size()) {
+			auto digits = name.substr(underscore + 1);
+			bool numeric = std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; });
+
+			if (numeric && (digits.size() == 1 || digits[0] != '0') && digits.size() < 10) {
+				auto base = names.Find(std::string_view(name).substr(0, underscore));
+				if (base >= 0) {
+					keys.push_back({ base, NAME_EXTERNAL_TO_INTERNAL(std::atoi(digits.c_str())) });
+				}
+			}
+		}
+
+		return keys;
+	}
+
+	// Calls pred(index, item) for every live slot, concurrently. item is a local copy.
+	// Returns the indices it accepted in ascending order.
+	template <typename Pred>
+	std::vector<int32_t> FindAll(Pred pred)
+	{
+		std::vector<int32_t> found;
+		std::mutex foundLock;
+
+		ForEachTask([&](int32_t begin, int32_t end, const FUObjectItem *items) {
+			std::vector<int32_t> local;
+
+			for (int32_t i = begin; i < end; ++i) {
+				const auto &item = items[i - begin];
+				if (item.Object != nullptr && pred(i, item)) {
+					local.push_back(i);
+				}
+			}
+
+			if (!local.empty()) {
+				std::lock_guard<std::mutex> _(foundLock);
+				found.insert(found.end(), local.begin(), local.end());
+			}
+		});
+
+		std::sort(found.begin(), found.end());
+		return found;
+	}
+
+	// Lowest accepted index, or -1. Later blocks stop early once a lower match is known.
+	template <typename Pred>
+	int32_t FindFirst(Pred pred)
+	{
+		std::atomic<int32_t> first = INT32_MAX;
+
+		ForEachTask([&](int32_t begin, int32_t end, const FUObjectItem *items) {
+			for (int32_t i = begin; i < end && i < first.load(std::memory_order_relaxed); ++i) {
+				const auto &item = items[i - begin];
+				if (item.Object != nullptr && pred(i, item)) {
+					StoreMin(first, i);
+					break;
+				}
+			}
+		});
+
+		return first == INT32_MAX ? -1 : first.load();
+	}
+
+	std::vector<int32_t> FindAllByName(const std::string &name)
+	{
+		auto keys = ResolveName(name);
+		std::vector<int32_t> found;
+		if (keys.empty()) {
+			return found;
+		}
+
+		std::mutex foundLock;
+		ForEachTask([&](int32_t begin, int32_t end, const FUObjectItem *items) {
+			std::vector<int32_t> local;
+			MatchBlock(keys, begin, end, items, [&](int32_t i) {
+				local.push_back(i);
+				return true;
+			});
+
+			if (!local.empty()) {
+				std::lock_guard<std::mutex> _(foundLock);
+				found.insert(found.end(), local.begin(), local.end());
+			}
+		});
+
+		std::sort(found.begin(), found.end());
+		return found;
+	}
+
+	// Address of the first object named name, nullptr when there is none
+	const UObjectBase *FindFirstByName(const std::string &name)
+	{
+		auto keys = ResolveName(name);
+		if (keys.empty()) {
+			return nullptr;
+		}
+
+		std::atomic<int32_t> first = INT32_MAX;
+		std::atomic<const UObjectBase *> object = nullptr;
+
+		ForEachTask([&](int32_t begin, int32_t end, const FUObjectItem *items) {
+			if (begin >= first.load(std::memory_order_relaxed)) {
+				return;
+			}
+
+			MatchBlock(keys, begin, end, items, [&](int32_t i) {
+				std::lock_guard<std::mutex> _(firstLock);
+				if (i < first) {
+					first = i;
+					object = items[i - begin].Object;
+				}
+				return false;
+			});
+		});
+
+		return object;
+	}
+
+private:
+	// Splits [0, NumElements) into SlotsPerTask sized pieces over the pool,
+	// fn gets a copy of the items of its piece
+	template <typename Fn>
+	void ForEachTask(Fn fn)
+	{
+		if (GUObjectArray == nullptr) {
+			return;
+		}
+
+		// objects added while scanning are not looked at
+		FChunkedFixedUObjectArray objects;
+		if (!memory.Read(&GUObjectArray->ObjObjects, objects)) {
+			return;
+		}
+
+		const int32_t num = objects.NumElements;
+		const int tasks = (int)((num + SlotsPerTask - 1) / SlotsPerTask);
+
+		pool.ParallelFor(tasks, [&](int task) {
+			int32_t begin = task * SlotsPerTask;
+			int32_t end = (std::min)(begin + SlotsPerTask, num);
+
+			// all slots of a task are in one chunk, so they are read in one go
+			thread_local std::vector<FUObjectItem> items;
+			items.resize(end - begin);
+
+			auto chunk = memory.Get(objects.Objects + begin / FChunkedFixedUObjectArray::NumElementsPerChunk);
+			auto within = begin % FChunkedFixedUObjectArray::NumElementsPerChunk;
+			if (chunk == nullptr || !memory.Read(chunk + within, items.data(), items.size() * sizeof(FUObjectItem))) {
+				return;
+			}
+
+			fn(begin, end, items.data());
+		});
+	}
+
+	// Calls onMatch(index) for slots in [begin, end) whose name is one of keys, until it returns false
+	template <typename OnMatch>
+	void MatchBlock(const std::vector<NameKey> &keys, int32_t begin, int32_t end, const FUObjectItem *items, OnMatch onMatch)
+	{
+		constexpr int32_t Batch = 1024;
+		alignas(16) int32_t indices[Batch];
+		FName fnames[Batch];
+		MemorySource::Range ranges[Batch];
+
+		// slots never hold these, padding and empty slots use them
+		constexpr int32_t Empty = -1;
+
+		const int32_t a = keys[0].ComparisonIndex;
+		const int32_t b = keys.size() > 1 ? keys[1].ComparisonIndex : a;
+
+		for (int32_t base = begin; base < end; base += Batch) {
+			const int32_t n = (std::min)(Batch, end - base);
+			const FUObjectItem *block = items + (base - begin);
+
+			// the names live in the objects, gather them in one batch
+			size_t count = 0;
+			for (int32_t k = 0; k < n; ++k) {
+				fnames[k] = { Empty, NAME_NO_NUMBER_INTERNAL };
+				if (block[k].Object != nullptr) {
+					ranges[count++] = { &block[k].Object->NamePrivate, &fnames[k], sizeof(FName) };
+				}
+			}
+			memory.ReadBatch(ranges, count);
+
+			for (int32_t k = 0; k < n; ++k) {
+				indices[k] = fnames[k].ComparisonIndex;
+			}
+
+			int32_t padded = (n + 3) & ~3;
+			for (int32_t k = n; k < padded; ++k) {
+				indices[k] = Empty;
+			}
+
+			for (int32_t k = 0; k < padded; k += 4) {
+#ifdef OBJECT_SCANNER_SSE2
+				auto v = _mm_load_si128((const __m128i *)&indices[k]);
+				auto eq = _mm_or_si128(_mm_cmpeq_epi32(v, _mm_set1_epi32(a)), _mm_cmpeq_epi32(v, _mm_set1_epi32(b)));
+				int mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+				if (mask == 0) {
+					continue;
+				}
+#else
+				int mask = 0;
+				for (int lane = 0; lane < 4; ++lane) {
+					if (indices[k + lane] == a || indices[k + lane] == b) {
+						mask |= 1 << lane;
+					}
+				}
+				if (mask == 0) {
+					continue;
+				}
+#endif
+
+				for (int lane = 0; lane < 4; ++lane) {
+					if (!(mask & (1 << lane))) {
+						continue;
+					}
+
+					const auto &fname = fnames[k + lane];
+					bool match = std::any_of(keys.begin(), keys.end(), [&](const NameKey &key) {
+						return key.ComparisonIndex == fname.ComparisonIndex && key.Number == fname.Number;
+					});
+
+					if (match && !onMatch(base + k + lane)) {
+						return;
+					}
+				}
+			}
+		}
+	}
+
+	static void StoreMin(std::atomic<int32_t> &target, int32_t value)
+	{
+		auto current = target.load();
+		while (value < current && !target.compare_exchange_weak(current, value)) {
+		}
+	}
+
+	const MemorySource &memory;
+	NameTable &names;
+	WorkerPool &pool;
+
+	std::mutex firstLock;
+};
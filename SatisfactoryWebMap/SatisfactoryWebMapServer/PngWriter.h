@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "Deflate.h"
+
+// 8-bit RGBA PNG. Every row uses the Sub filter, which is cheap and does well on map art,
+// the zlib stream comes from Deflate.h.
+inline std::string EncodePng(const uint8_t *rgba, int width, int height, int level)
+{
+	const size_t stride = (size_t)width * 4;
+
+	std::string filtered;
+	filtered.resize((stride + 1) * height);
+	for (int y = 0; y < height; ++y) {
+		const uint8_t *row = rgba + stride * y;
+		auto *out = (uint8_t *)&filtered[(stride + 1) * y];
+
+		*out++ = 1; // Sub
+		for (size_t i = 0; i < stride; ++i) {
+			out[i] = (uint8_t)(row[i] - (i >= 4 ? row[i - 4] : 0));
+		}
+	}
+
+	std::string png("\x89PNG\r\n\x1a\n", 8);
+
+	auto u32 = [&](uint32_t v) {
+		png += (char)(v >> 24);
+		png += (char)(v >> 16);
+		png += (char)(v >> 8);
+		png += (char)v;
+	};
+
+	auto chunk = [&](const char *type, const std::string &data) {
+		u32((uint32_t)data.size());
+		auto start = png.size();
+		png.append(type, 4);
+		png += data;
+		u32(deflate::Crc32(png.data() + start, png.size() - start));
+	};
+
+	std::string header;
+	for (uint32_t v : { (uint32_t)width, (uint32_t)height }) {
+		header += (char)(v >> 24);
+		header += (char)(v >> 16);
+		header += (char)(v >> 8);
+		header += (char)v;
+	}
+	header += (char)8; // bit depth
+	header += (char)6; // RGBA
+	header.append(3, '\0'); // deflate, adaptive filtering, no interlace
+
+	chunk("IHDR", header);
+	chunk("IDAT", deflate::Zlib(filtered, level));
+	chunk("IEND", "");
+	return png;
+}
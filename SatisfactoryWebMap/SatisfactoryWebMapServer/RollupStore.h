@@ -0,0 +1,289 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Snapshot.h"
+
+// Where the moving actors were over long sessions, for /api/rollups: every actor's positions
+// summed up per 1 s, 10 s, 1 min and 10 min bucket, each tier a ring going back further than the
+// one before (10 min, 2 h, a day, 10 days).
+//
+// A bucket keeps the last position in it, the bounding box of the path through it and the distance
+// moved, in metres. Buckets are only written when the actor moved, so parked actors cost nothing and
+// one moving all the time holds at most about 90 KB. A query takes the finest tier that reaches back
+// to its start and answers with no more buckets per actor than its point budget, so a timeline over
+// days reads a few hundred 10 min buckets instead of every sample.
+class RollupStore
+{
+public:
+	struct Tier
+	{
+		int64_t Resolution; // ms per bucket
+		size_t Capacity;    // buckets kept per actor
+	};
+
+	static constexpr int Tiers = 4;
+	static constexpr Tier Levels[Tiers] = {
+		{ 1000, 600 },
+		{ 10 * 1000, 720 },
+		{ 60 * 1000, 1440 },
+		{ 600 * 1000, 1440 },
+	};
+
+	struct Bucket
+	{
+		int32_t Slot;        // start time / Resolution
+		int16_t Last[3];     // metres
+		int16_t Box[4];      // minX, minY, maxX, maxY in metres, with where the actor came from
+		float Distance;      // metres
+	};
+
+	struct Series
+	{
+		int32_t Index;
+		int8_t Type;
+		int Tier;
+		std::vector<Bucket> Buckets;
+	};
+
+	explicit RollupStore(bool recordStatic = false) : recordStatic(recordStatic)
+	{}
+
+	RollupStore(const RollupStore &) = delete;
+	RollupStore &operator=(const RollupStore &) = delete;
+
+	~RollupStore()
+	{
+		Stop();
+	}
+
+	// Adds every version engine publishes, on a thread of its own
+	void Follow(SnapshotEngine &engine)
+	{
+		Stop();
+		following = true;
+
+		worker = std::thread([this, &engine] {
+			uint64_t seq = 0;
+			while (following) {
+				if (!engine.IsRunning()) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(100));
+					continue;
+				}
+
+				auto snapshot = engine.WaitNewer(seq, std::chrono::milliseconds(500));
+				if (snapshot && snapshot->Seq > seq) {
+					seq = snapshot->Seq;
+					if (snapshot->Valid) {
+						Record(*snapshot);
+					}
+				}
+			}
+		});
+	}
+
+	void Stop()
+	{
+		following = false;
+		if (worker.joinable()) {
+			worker.join();
+		}
+	}
+
+	void Record(const Snapshot &snapshot)
+	{
+		std::unique_lock<std::shared_mutex> _(lock);
+
+		for (const auto &actor : snapshot.Actors) {
+			if ((actor.IsStatic && !recordStatic) || !std::isfinite(actor.Location[0]) || !std::isfinite(actor.Location[1]) ||
+				!std::isfinite(actor.Location[2])) {
+				continue;
+			}
+
+			auto &rollup = rollups[actor.Index];
+			rollup.Type = actor.Type;
+			rollup.Add(snapshot.Time, actor.Location);
+		}
+
+		// gone actors stay until their newest bucket fell out of the last tier
+		const int64_t cutoff = snapshot.Time - Levels[Tiers - 1].Resolution * (int64_t)Levels[Tiers - 1].Capacity;
+		for (auto it = rollups.begin(); it != rollups.end();) {
+			if (it->second.Time < cutoff) {
+				it = rollups.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	// The tier for the unix times from..to in ms at no more than points buckets per actor
+	static int PickTier(int64_t from, int64_t to, size_t points, int64_t now)
+	{
+		for (int tier = 0; tier < Tiers - 1; ++tier) {
+			const auto &level = Levels[tier];
+			bool reaches = from >= now - level.Resolution * (int64_t)level.Capacity;
+			bool fits = (to - from) / level.Resolution < (int64_t)points;
+			if (reaches && fits) {
+				return tier;
+			}
+		}
+		return Tiers - 1;
+	}
+
+	// Buckets of one actor from..to in tier, false when the actor is unknown
+	bool Get(int32_t index, int tier, int64_t from, int64_t to, Series &out) const
+	{
+		std::shared_lock<std::shared_mutex> _(lock);
+
+		auto it = rollups.find(index);
+		if (it == rollups.end()) {
+			return false;
+		}
+
+		out.Index = index;
+		out.Type = it->second.Type;
+		out.Tier = tier;
+		out.Buckets.clear();
+		it->second.Rings[tier].Copy(ToSlot(from, tier), ToSlot(to, tier), out.Buckets);
+		return true;
+	}
+
+	// Buckets from..to in tier of every actor whose path crossed box then, in Index order
+	void Find(const float box[4], int tier, int64_t from, int64_t to, std::vector<Series> &out) const
+	{
+		const int16_t area[4] = { ToMetre(box[0]), ToMetre(box[1]), ToMetre(box[2]), ToMetre(box[3]) };
+		const int32_t first = ToSlot(from, tier), last = ToSlot(to, tier);
+
+		out.clear();
+
+		std::shared_lock<std::shared_mutex> _(lock);
+		for (const auto &[index, rollup] : rollups) {
+			Series series{ index, rollup.Type, tier, {} };
+			rollup.Rings[tier].Copy(first, last, series.Buckets);
+
+			bool crossed = std::any_of(series.Buckets.begin(), series.Buckets.end(), [&](const Bucket &b) {
+				return b.Box[0] <= area[2] && b.Box[2] >= area[0] && b.Box[1] <= area[3] && b.Box[3] >= area[1];
+			});
+			if (crossed) {
+				out.push_back(std::move(series));
+			}
+		}
+
+		std::sort(out.begin(), out.end(), [](const Series &a, const Series &b) {
+			return a.Index < b.Index;
+		});
+	}
+
+	static int32_t ToSlot(int64_t time, int tier)
+	{
+		auto slot = time / Levels[tier].Resolution;
+		return (int32_t)(std::min)((std::max)(slot, (int64_t)INT32_MIN), (int64_t)INT32_MAX);
+	}
+
+private:
+	static int16_t ToMetre(double v)
+	{
+		return (int16_t)std::lround((std::min)((std::max)(v / 100, -32768.), 32767.));
+	}
+
+	// At most Capacity buckets, the oldest overwritten first
+	struct Ring
+	{
+		std::vector<Bucket> Items;
+		size_t Oldest = 0;
+
+		Bucket *Newest()
+		{
+			if (Items.empty()) {
+				return nullptr;
+			}
+			return &Items[(Oldest + Items.size() - 1) % Items.size()];
+		}
+
+		void Push(const Bucket &bucket, size_t capacity)
+		{
+			if (Items.size() < capacity) {
+				Items.push_back(bucket);
+			} else {
+				Items[Oldest] = bucket;
+				Oldest = (Oldest + 1) % Items.size();
+			}
+		}
+
+		void Copy(int32_t first, int32_t last, std::vector<Bucket> &out) const
+		{
+			for (size_t i = 0; i < Items.size(); ++i) {
+				const auto &bucket = Items[(Oldest + i) % Items.size()];
+				if (bucket.Slot >= first && bucket.Slot <= last) {
+					out.push_back(bucket);
+				}
+			}
+		}
+	};
+
+	struct Rollup
+	{
+		int8_t Type = 0;
+		int64_t Time = 0;
+		bool HasLast = false;
+		double Last[3];
+		Ring Rings[Tiers];
+
+		void Add(int64_t time, const float location[3])
+		{
+			double step = 0;
+			if (HasLast) {
+				double dx = location[0] - Last[0], dy = location[1] - Last[1], dz = location[2] - Last[2];
+				step = std::sqrt(dx * dx + dy * dy + dz * dz) / 100;
+
+				// still where it was, nothing to write
+				if (step < 0.5) {
+					return;
+				}
+			}
+
+			const int16_t at[3] = { ToMetre(location[0]), ToMetre(location[1]), ToMetre(location[2]) };
+			const int16_t from[2] = { HasLast ? ToMetre(Last[0]) : at[0], HasLast ? ToMetre(Last[1]) : at[1] };
+
+			for (int tier = 0; tier < Tiers; ++tier) {
+				auto slot = ToSlot(time, tier);
+				auto &ring = Rings[tier];
+
+				auto *bucket = ring.Newest();
+				if (bucket == nullptr || bucket->Slot != slot) {
+					Bucket fresh{ slot, {}, { from[0], from[1], from[0], from[1] }, 0.f };
+					ring.Push(fresh, Levels[tier].Capacity);
+					bucket = ring.Newest();
+				}
+
+				std::copy(at, at + 3, bucket->Last);
+				bucket->Box[0] = (std::min)(bucket->Box[0], at[0]);
+				bucket->Box[1] = (std::min)(bucket->Box[1], at[1]);
+				bucket->Box[2] = (std::max)(bucket->Box[2], at[0]);
+				bucket->Box[3] = (std::max)(bucket->Box[3], at[1]);
+				bucket->Distance += (float)step;
+			}
+
+			std::copy(location, location + 3, Last);
+			HasLast = true;
+			Time = time;
+		}
+	};
+
+	bool recordStatic;
+
+	mutable std::shared_mutex lock;
+	std::unordered_map<int32_t, Rollup> rollups;
+
+	std::atomic<bool> following = false;
+	std::thread worker;
+};
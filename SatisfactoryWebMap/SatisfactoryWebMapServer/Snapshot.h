@@ -0,0 +1,317 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+
+#include "Hash.h"
+#include "SpatialGrid.h"
+#include "ClusterIndex.h"
+
+// Plain copy of one actor representation, taken by the snapshot thread
+struct ActorState
+{
+	int32_t Index;
+	int8_t Type;
+
+	float Location[3];
+	float Rotation[3];
+	float Velocity[3];
+	bool HasVelocity;
+
+	// buildings and other things that never move
+	bool IsStatic;
+
+	int32_t Color[4];
+
+	// change detection key over type, location, rotation, velocity and color
+	uint64_t Hash;
+};
+
+inline uint64_t HashActorState(const ActorState &state)
+{
+	auto hash = Fnv1a64(&state.Type, sizeof(state.Type));
+	hash = Fnv1a64(state.Location, sizeof(state.Location), hash);
+	hash = Fnv1a64(state.Rotation, sizeof(state.Rotation), hash);
+	hash = Fnv1a64(&state.HasVelocity, sizeof(state.HasVelocity), hash);
+	if (state.HasVelocity) {
+		hash = Fnv1a64(state.Velocity, sizeof(state.Velocity), hash);
+	}
+	hash = Fnv1a64(state.Color, sizeof(state.Color), hash);
+	return hash;
+}
+
+// Immutable result of one walk over the representation manager.
+// Once published it is shared by every handler and never modified.
+struct Snapshot
+{
+	uint64_t Seq;
+	int64_t Time; // unix time in ms
+
+	bool Valid;
+	std::string Error;
+
+	std::vector<ActorState> Actors;
+
+	// Actors by map cell, for bounding box queries
+	SpatialGrid Grid;
+
+	// /api/actors response, serialized once per version
+	std::string Body;
+	std::string ETag;
+
+	// delta bodies against older versions, filled on first request
+	mutable std::mutex DeltaLock;
+	mutable std::unordered_map<uint64_t, std::shared_ptr<const std::string>> DeltaBodies;
+
+	// other encodings of this version, built by the first request that needs one
+	mutable std::mutex VariantLock;
+	mutable std::unordered_map<std::string, std::shared_ptr<const std::string>> Variants;
+
+	template <typename Build>
+	std::shared_ptr<const std::string> Variant(const std::string &name, Build build) const
+	{
+		std::lock_guard<std::mutex> _(VariantLock);
+
+		auto &body = Variants[name];
+		if (!body) {
+			body = std::make_shared<const std::string>(build(*this));
+		}
+		return body;
+	}
+
+	// zoom levels of /api/clusters, built by the first request that needs them
+	const ClusterIndex &Clusters() const
+	{
+		std::call_once(ClustersOnce, [this] {
+			ClusterLevels.Build(Actors);
+		});
+		return ClusterLevels;
+	}
+
+	mutable std::once_flag ClustersOnce;
+	mutable ClusterIndex ClusterLevels;
+};
+
+using SnapshotPtr = std::shared_ptr<const Snapshot>;
+
+// Changes between two versions, both sides sorted by Index
+struct SnapshotDelta
+{
+	std::vector<const ActorState *> Added;
+	std::vector<const ActorState *> Changed;
+	std::vector<int32_t> Removed;
+};
+
+inline void DiffSnapshots(const Snapshot &from, const Snapshot &to, SnapshotDelta &delta)
+{
+	auto a = from.Actors.begin(), aend = from.Actors.end();
+	auto b = to.Actors.begin(), bend = to.Actors.end();
+
+	while (a != aend || b != bend) {
+		if (b == bend || (a != aend && a->Index < b->Index)) {
+			delta.Removed.push_back(a->Index);
+			++a;
+		} else if (a == aend || b->Index < a->Index) {
+			delta.Added.push_back(&*b);
+			++b;
+		} else {
+			if (a->Hash != b->Hash) {
+				delta.Changed.push_back(&*b);
+			}
+			++a;
+			++b;
+		}
+	}
+}
+
+class SnapshotEngine
+{
+public:
+	// Fills actors from game memory, returns false and sets error when the game objects are unavailable
+	using Sampler = std::function<bool(std::vector<ActorState> &actors, std::string &error)>;
+	using Serializer = std::function<std::string(const Snapshot &snapshot)>;
+
+	SnapshotEngine() = default;
+	SnapshotEngine(const SnapshotEngine &) = delete;
+	SnapshotEngine &operator=(const SnapshotEngine &) = delete;
+
+	~SnapshotEngine()
+	{
+		Stop();
+	}
+
+	void Start(Sampler sampler, Serializer serializer, int intervalMs, int historySize)
+	{
+		Stop();
+
+		this->historySize = (size_t)(std::max)(historySize, 1);
+
+		this->sampler = std::move(sampler);
+		this->serializer = std::move(serializer);
+		interval = std::chrono::milliseconds(intervalMs > 0 ? intervalMs : 1);
+		running = true;
+
+		worker = std::thread([this] { Run(); });
+	}
+
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> _(m);
+			running = false;
+		}
+		cv.notify_all();
+
+		{
+			std::lock_guard<std::mutex> _(publishLock);
+		}
+		publishCv.notify_all();
+
+		if (worker.joinable()) {
+			worker.join();
+		}
+	}
+
+	bool IsRunning() const
+	{
+		return running;
+	}
+
+	// Latest published snapshot, nullptr before the first sample
+	SnapshotPtr Latest() const
+	{
+		return std::atomic_load(&latest);
+	}
+
+	// Blocks until a version newer than seq is published, the engine stops or timeout passes
+	SnapshotPtr WaitNewer(uint64_t seq, std::chrono::milliseconds timeout)
+	{
+		std::unique_lock<std::mutex> lock(publishLock);
+		publishCv.wait_for(lock, timeout, [&] {
+			auto snapshot = Latest();
+			return !running || (snapshot && snapshot->Seq > seq);
+		});
+
+		return Latest();
+	}
+
+	// An older version still kept for deltas, nullptr once it fell out of the history
+	SnapshotPtr Find(uint64_t seq) const
+	{
+		std::lock_guard<std::mutex> _(historyLock);
+		for (const auto &snapshot : history) {
+			if (snapshot->Seq == seq) {
+				return snapshot;
+			}
+		}
+		return nullptr;
+	}
+
+private:
+	void Run()
+	{
+		uint64_t seq = 0;
+		size_t lastSize = 0;
+
+		std::unique_lock<std::mutex> lock(m);
+		while (running) {
+			auto start = std::chrono::steady_clock::now();
+
+			lock.unlock();
+			{
+				auto next = std::make_shared<Snapshot>();
+				next->Actors.reserve(lastSize);
+				next->Valid = sampler(next->Actors, next->Error);
+
+				for (auto &actor : next->Actors) {
+					actor.Hash = HashActorState(actor);
+				}
+				std::sort(next->Actors.begin(), next->Actors.end(), [](const ActorState &a, const ActorState &b) {
+					return a.Index < b.Index;
+				});
+
+				lastSize = next->Actors.size();
+
+				// nothing read changed, keep serving the current version without serializing it again
+				auto current = Latest();
+				if (!current || !SameSample(*current, *next)) {
+					next->Time = std::chrono::duration_cast<std::chrono::milliseconds>(
+						std::chrono::system_clock::now().time_since_epoch()).count();
+					next->Body = serializer(*next);
+					next->ETag = "\"" + HashToHex(Fnv1a64(next->Body)) + "\"";
+
+					// the body can still come out the same, IsStatic is not in it
+					if (!current || current->ETag != next->ETag) {
+						next->Seq = ++seq;
+						next->Grid.Build(next->Actors);
+						Publish(SnapshotPtr(std::move(next)));
+					}
+				}
+			}
+			lock.lock();
+
+			cv.wait_until(lock, start + interval, [this] { return !running; });
+		}
+	}
+
+	// Same actors with the same fields as a published version, Actors sorted in both
+	static bool SameSample(const Snapshot &a, const Snapshot &b)
+	{
+		if (a.Valid != b.Valid || a.Error != b.Error || a.Actors.size() != b.Actors.size()) {
+			return false;
+		}
+
+		return std::equal(a.Actors.begin(), a.Actors.end(), b.Actors.begin(), [](const ActorState &x, const ActorState &y) {
+			return x.Index == y.Index && x.Hash == y.Hash && x.IsStatic == y.IsStatic && x.HasVelocity == y.HasVelocity &&
+				!std::memcmp(x.Location, y.Location, sizeof(x.Location)) && !std::memcmp(x.Velocity, y.Velocity, sizeof(x.Velocity));
+		});
+	}
+
+	void Publish(SnapshotPtr snapshot)
+	{
+		{
+			std::lock_guard<std::mutex> _(historyLock);
+			history.push_back(snapshot);
+			while (history.size() > historySize) {
+				history.pop_front();
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> _(publishLock);
+			std::atomic_store(&latest, std::move(snapshot));
+		}
+		publishCv.notify_all();
+	}
+
+	Sampler sampler;
+	Serializer serializer;
+	std::chrono::milliseconds interval{ 1000 };
+
+	std::atomic<bool> running = false;
+	std::thread worker;
+
+	std::mutex m;
+	std::condition_variable cv;
+
+	SnapshotPtr latest;
+
+	std::mutex publishLock;
+	std::condition_variable publishCv;
+
+	size_t historySize = 1;
+	mutable std::mutex historyLock;
+	std::deque<SnapshotPtr> history;
+};
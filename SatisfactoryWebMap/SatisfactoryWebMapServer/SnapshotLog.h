@@ -0,0 +1,728 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Deflate.h"
+#include "MemorySource.h"
+#include "Snapshot.h"
+
+// Every published snapshot, appended to files on disk, for /api/actors?at=.
+//
+// The log is a directory of segments named after the unix time in ms of their first record. A
+// segment is the 8 byte header "SWML" u32 version followed by records, little endian:
+//
+//   u32 size, u32 crc32 of the body, body:
+//     u8 kind       Keyframe or Delta
+//     u64 seq, i64 time (unix ms)
+//     keyframe      varint count, then count actors
+//     delta         varint removed, removed index steps, varint changed, then changed actors
+//
+// An actor is its index as a step from the previous one (zigzag varint), a byte of Changed bits and
+// the fields those name: location in cm and velocity in cm/s as zigzag varint steps from the last
+// record, rotation as 3 floats, type, flags and rgba as bytes. A keyframe writes every field, so
+// it replays on its own; every segment starts with one and so does every KeyframeEvery-th record.
+//
+// A writer thread follows the snapshot engine, so the snapshot thread never waits for the disk; when
+// it falls behind it skips versions, the next delta covers them. Each record is flushed as it is
+// written. The game taking the dll down tears at most the last record, which fails its size or crc
+// check and ends the replay of that segment; a new run always starts a new segment. The oldest
+// segments are deleted once the log is larger than its budget.
+class SnapshotLog
+{
+public:
+	static constexpr uint32_t Version = 1;
+	static constexpr uint64_t SegmentBytes = 64ull << 20;
+	static constexpr int KeyframeEvery = 60;
+
+	SnapshotLog() = default;
+
+	SnapshotLog(const SnapshotLog &) = delete;
+	SnapshotLog &operator=(const SnapshotLog &) = delete;
+
+	~SnapshotLog()
+	{
+		Stop();
+	}
+
+	// Starts logging what engine publishes into dir, keeping at most maxBytes of segments
+	bool Start(SnapshotEngine &engine, const std::string &dir, uint64_t maxBytes)
+	{
+		Stop();
+
+		std::error_code ec;
+		std::filesystem::create_directories(dir, ec);
+		if (!std::filesystem::is_directory(dir, ec)) {
+			return false;
+		}
+
+		this->dir = dir;
+		this->maxBytes = maxBytes;
+		running = true;
+
+		worker = std::thread([this, &engine] {
+			Scan();
+			Run(engine);
+		});
+		return true;
+	}
+
+	void Stop()
+	{
+		running = false;
+		if (worker.joinable()) {
+			worker.join();
+		}
+	}
+
+	// The actors as they were at a unix time in ms, nullptr when the log does not go back that far.
+	// Replays from the keyframe before time, straight from the mapped segment.
+	SnapshotPtr At(int64_t time) const
+	{
+		std::string path;
+		uint64_t offset = 0, end = 0;
+		{
+			std::lock_guard<std::mutex> _(lock);
+
+			auto segment = std::upper_bound(segments.begin(), segments.end(), time, [](int64_t t, const Segment &s) {
+				return t < s.First;
+			});
+			if (segment == segments.begin()) {
+				return nullptr;
+			}
+			--segment;
+
+			auto keyframe = std::upper_bound(segment->Keyframes.begin(), segment->Keyframes.end(), time,
+				[](int64_t t, const std::pair<int64_t, uint64_t> &k) {
+					return t < k.first;
+				});
+			if (keyframe == segment->Keyframes.begin()) {
+				return nullptr;
+			}
+			--keyframe;
+
+			path = segment->Path;
+			offset = keyframe->second;
+			end = segment->Bytes;
+		}
+
+		MappedFile file;
+		if (!file.Open(path)) {
+			return nullptr;
+		}
+		end = (std::min)(end, (uint64_t)file.Size());
+
+		auto snapshot = std::make_shared<Snapshot>();
+		snapshot->Valid = true;
+
+		Record record;
+		bool found = false;
+		std::vector<ActorState> next;
+		while (ReadRecord(file.Data(), end, offset, record) && record.Time <= time) {
+			if (!Apply(record, snapshot->Actors, next)) {
+				break;
+			}
+			snapshot->Actors.swap(next);
+			snapshot->Seq = record.Seq;
+			snapshot->Time = record.Time;
+			found = true;
+		}
+		if (!found) {
+			return nullptr;
+		}
+
+		for (auto &actor : snapshot->Actors) {
+			actor.Hash = HashActorState(actor);
+		}
+		snapshot->Grid.Build(snapshot->Actors);
+		return snapshot;
+	}
+
+	// unix times in ms of the first and last record, false when the log is empty
+	bool Range(int64_t &first, int64_t &last) const
+	{
+		std::lock_guard<std::mutex> _(lock);
+		if (segments.empty() || segments.front().Keyframes.empty()) {
+			return false;
+		}
+		first = segments.front().Keyframes.front().first;
+		last = segments.back().Last;
+		return true;
+	}
+
+private:
+	enum : uint8_t
+	{
+		Keyframe = 1,
+		Delta = 2,
+	};
+
+	// which fields of an actor a record holds
+	enum : uint8_t
+	{
+		ChangedLocation = 1 << 0,
+		ChangedRotation = 1 << 1,
+		ChangedVelocity = 1 << 2,
+		ChangedLook = 1 << 3, // type, flags and color
+		ChangedAll = 0x0f,
+	};
+
+	enum : uint8_t
+	{
+		FlagHasVelocity = 1 << 0,
+		FlagIsStatic = 1 << 1,
+	};
+
+	static constexpr size_t RecordHeader = 8;
+	static constexpr size_t BodyHeader = 1 + 8 + 8;
+
+	struct Segment
+	{
+		std::string Path;
+		int64_t First = 0, Last = 0;
+		uint64_t Bytes = 0;                                 // valid part of the file
+		std::vector<std::pair<int64_t, uint64_t>> Keyframes; // time, offset
+	};
+
+	struct Record
+	{
+		uint8_t Kind;
+		uint64_t Seq;
+		int64_t Time;
+		const uint8_t *Data; // after the body header
+		const uint8_t *End;
+	};
+
+	// Reads the record at offset and moves past it, false at the end or at a torn or corrupt record
+	static bool ReadRecord(const char *data, uint64_t size, uint64_t &offset, Record &record)
+	{
+		if (offset + RecordHeader + BodyHeader > size) {
+			return false;
+		}
+
+		auto p = (const uint8_t *)data + offset;
+		uint32_t length = (uint32_t)Get(p, 4), crc = (uint32_t)Get(p + 4, 4);
+		if (length < BodyHeader || offset + RecordHeader + length > size || deflate::Crc32(p + RecordHeader, length) != crc) {
+			return false;
+		}
+
+		auto body = p + RecordHeader;
+		record.Kind = body[0];
+		record.Seq = Get(body + 1, 8);
+		record.Time = (int64_t)Get(body + 9, 8);
+		record.Data = body + BodyHeader;
+		record.End = body + length;
+
+		offset += RecordHeader + length;
+		return record.Kind == Keyframe || record.Kind == Delta;
+	}
+
+	static uint64_t Get(const uint8_t *p, int bytes)
+	{
+		uint64_t v = 0;
+		for (int i = 0; i < bytes; ++i) {
+			v |= (uint64_t)p[i] << (i * 8);
+		}
+		return v;
+	}
+
+	static void Put(std::string &out, uint64_t v, int bytes)
+	{
+		for (int i = 0; i < bytes; ++i) {
+			out += (char)(v >> (i * 8));
+		}
+	}
+
+	static void PutVarint(std::string &out, uint64_t v)
+	{
+		while (v >= 0x80) {
+			out += (char)(v | 0x80);
+			v >>= 7;
+		}
+		out += (char)v;
+	}
+
+	static void PutSigned(std::string &out, int64_t v)
+	{
+		PutVarint(out, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+	}
+
+	static bool GetVarint(const uint8_t *&p, const uint8_t *end, uint64_t &v)
+	{
+		v = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (p == end) {
+				return false;
+			}
+			uint8_t b = *p++;
+			v |= (uint64_t)(b & 0x7f) << shift;
+			if (!(b & 0x80)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static bool GetSigned(const uint8_t *&p, const uint8_t *end, int64_t &v)
+	{
+		uint64_t u;
+		if (!GetVarint(p, end, u)) {
+			return false;
+		}
+		v = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+		return true;
+	}
+
+	static int64_t Cm(float v)
+	{
+		return std::isfinite(v) ? std::llround((std::min)((std::max)((double)v, -1e15), 1e15)) : 0;
+	}
+
+	static uint8_t Flags(const ActorState &actor)
+	{
+		return (actor.HasVelocity ? FlagHasVelocity : 0) | (actor.IsStatic ? FlagIsStatic : 0);
+	}
+
+	// fields of actor that are not what was last written for it
+	static uint8_t Changes(const ActorState *before, const ActorState &actor)
+	{
+		if (before == nullptr) {
+			return ChangedAll;
+		}
+
+		uint8_t changed = 0;
+		for (int i = 0; i < 3; ++i) {
+			if (Cm(before->Location[i]) != Cm(actor.Location[i])) {
+				changed |= ChangedLocation;
+			}
+			if (Cm(before->Velocity[i]) != Cm(actor.Velocity[i])) {
+				changed |= ChangedVelocity;
+			}
+		}
+		if (std::memcmp(before->Rotation, actor.Rotation, sizeof(actor.Rotation)) != 0) {
+			changed |= ChangedRotation;
+		}
+		if (before->Type != actor.Type || Flags(*before) != Flags(actor) ||
+			std::memcmp(before->Color, actor.Color, sizeof(actor.Color)) != 0) {
+			changed |= ChangedLook;
+		}
+		return changed;
+	}
+
+	static void PutActor(std::string &out, int32_t &lastIndex, const ActorState *before, const ActorState &actor, uint8_t changed)
+	{
+		PutSigned(out, (int64_t)actor.Index - lastIndex);
+		lastIndex = actor.Index;
+		out += (char)changed;
+
+		if (changed & ChangedLocation) {
+			for (int i = 0; i < 3; ++i) {
+				PutSigned(out, Cm(actor.Location[i]) - (before ? Cm(before->Location[i]) : 0));
+			}
+		}
+		if (changed & ChangedRotation) {
+			for (float v : actor.Rotation) {
+				uint32_t bits;
+				std::memcpy(&bits, &v, sizeof(bits));
+				Put(out, bits, 4);
+			}
+		}
+		if (changed & ChangedVelocity) {
+			for (int i = 0; i < 3; ++i) {
+				PutSigned(out, Cm(actor.Velocity[i]) - (before ? Cm(before->Velocity[i]) : 0));
+			}
+		}
+		if (changed & ChangedLook) {
+			out += (char)actor.Type;
+			out += (char)Flags(actor);
+			for (auto c : actor.Color) {
+				out += (char)c;
+			}
+		}
+	}
+
+	// Reads one actor on top of before (or nothing), false on bad data
+	static bool GetActor(const uint8_t *&p, const uint8_t *end, int32_t &lastIndex, const ActorState *before, ActorState &actor)
+	{
+		int64_t step;
+		if (!GetSigned(p, end, step) || p == end) {
+			return false;
+		}
+		uint8_t changed = *p++;
+
+		if (before != nullptr) {
+			actor = *before;
+		} else {
+			actor = {};
+			if (changed != ChangedAll) {
+				return false;
+			}
+		}
+		actor.Index = lastIndex = (int32_t)(lastIndex + step);
+
+		if (changed & ChangedLocation) {
+			for (int i = 0; i < 3; ++i) {
+				int64_t v;
+				if (!GetSigned(p, end, v)) {
+					return false;
+				}
+				actor.Location[i] = (float)((before ? Cm(before->Location[i]) : 0) + v);
+			}
+		}
+		if (changed & ChangedRotation) {
+			if (end - p < 12) {
+				return false;
+			}
+			for (auto &v : actor.Rotation) {
+				uint32_t bits = (uint32_t)Get(p, 4);
+				std::memcpy(&v, &bits, sizeof(v));
+				p += 4;
+			}
+		}
+		if (changed & ChangedVelocity) {
+			for (int i = 0; i < 3; ++i) {
+				int64_t v;
+				if (!GetSigned(p, end, v)) {
+					return false;
+				}
+				actor.Velocity[i] = (float)((before ? Cm(before->Velocity[i]) : 0) + v);
+			}
+		}
+		if (changed & ChangedLook) {
+			if (end - p < 6) {
+				return false;
+			}
+			actor.Type = (int8_t)*p++;
+			uint8_t flags = *p++;
+			actor.HasVelocity = flags & FlagHasVelocity;
+			actor.IsStatic = flags & FlagIsStatic;
+			for (auto &c : actor.Color) {
+				c = *p++;
+			}
+		}
+		return true;
+	}
+
+	static std::string EncodeKeyframe(const Snapshot &snapshot)
+	{
+		std::string body;
+		body.reserve(BodyHeader + 8 + snapshot.Actors.size() * 32);
+		body += (char)Keyframe;
+		Put(body, snapshot.Seq, 8);
+		Put(body, (uint64_t)snapshot.Time, 8);
+
+		PutVarint(body, snapshot.Actors.size());
+		int32_t lastIndex = 0;
+		for (const auto &actor : snapshot.Actors) {
+			PutActor(body, lastIndex, nullptr, actor, ChangedAll);
+		}
+		return body;
+	}
+
+	// Changes from base to snapshot, both sorted by Index
+	static std::string EncodeDelta(const Snapshot &base, const Snapshot &snapshot)
+	{
+		std::string removed, changed;
+		size_t removedCount = 0, changedCount = 0;
+		int32_t removedIndex = 0, changedIndex = 0;
+
+		auto a = base.Actors.begin(), aend = base.Actors.end();
+		auto b = snapshot.Actors.begin(), bend = snapshot.Actors.end();
+		while (a != aend || b != bend) {
+			if (b == bend || (a != aend && a->Index < b->Index)) {
+				PutSigned(removed, (int64_t)a->Index - removedIndex);
+				removedIndex = a->Index;
+				++removedCount;
+				++a;
+			} else if (a == aend || b->Index < a->Index) {
+				PutActor(changed, changedIndex, nullptr, *b, ChangedAll);
+				++changedCount;
+				++b;
+			} else {
+				if (auto fields = Changes(&*a, *b)) {
+					PutActor(changed, changedIndex, &*a, *b, fields);
+					++changedCount;
+				}
+				++a;
+				++b;
+			}
+		}
+
+		std::string body;
+		body.reserve(BodyHeader + 16 + removed.size() + changed.size());
+		body += (char)Delta;
+		Put(body, snapshot.Seq, 8);
+		Put(body, (uint64_t)snapshot.Time, 8);
+		PutVarint(body, removedCount);
+		body += removed;
+		PutVarint(body, changedCount);
+		body += changed;
+		return body;
+	}
+
+	// Actors after record, from the actors before it
+	static bool Apply(const Record &record, const std::vector<ActorState> &actors, std::vector<ActorState> &next)
+	{
+		auto p = record.Data;
+		next.clear();
+
+		if (record.Kind == Keyframe) {
+			uint64_t count;
+			if (!GetVarint(p, record.End, count) || count > (uint64_t)(record.End - p)) {
+				return false;
+			}
+
+			next.resize((size_t)count);
+			int32_t lastIndex = 0;
+			for (auto &actor : next) {
+				if (!GetActor(p, record.End, lastIndex, nullptr, actor)) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		uint64_t count;
+		if (!GetVarint(p, record.End, count) || count > (uint64_t)(record.End - p)) {
+			return false;
+		}
+		std::vector<int32_t> removed((size_t)count);
+		int32_t lastIndex = 0;
+		for (auto &index : removed) {
+			int64_t step;
+			if (!GetSigned(p, record.End, step)) {
+				return false;
+			}
+			index = lastIndex = (int32_t)(lastIndex + step);
+		}
+
+		if (!GetVarint(p, record.End, count) || count > (uint64_t)(record.End - p)) {
+			return false;
+		}
+
+		// merge the sorted changes into the sorted actors
+		auto a = actors.begin(), aend = actors.end();
+		auto r = removed.begin();
+		lastIndex = 0;
+		for (uint64_t n = 0; n < count; ++n) {
+			// peek the index of the next change
+			auto q = p;
+			int64_t step;
+			if (!GetSigned(q, record.End, step)) {
+				return false;
+			}
+			int32_t index = (int32_t)(lastIndex + step);
+
+			for (; a != aend && a->Index < index; ++a) {
+				while (r != removed.end() && *r < a->Index) {
+					++r;
+				}
+				if (r == removed.end() || *r != a->Index) {
+					next.push_back(*a);
+				}
+			}
+
+			const ActorState *before = a != aend && a->Index == index ? &*a : nullptr;
+			next.emplace_back();
+			if (!GetActor(p, record.End, lastIndex, before, next.back())) {
+				return false;
+			}
+			if (before) {
+				++a;
+			}
+		}
+		for (; a != aend; ++a) {
+			while (r != removed.end() && *r < a->Index) {
+				++r;
+			}
+			if (r == removed.end() || *r != a->Index) {
+				next.push_back(*a);
+			}
+		}
+		return true;
+	}
+
+	// Indexes the segments already in the directory, the valid part of each
+	void Scan()
+	{
+		namespace fs = std::filesystem;
+
+		std::vector<Segment> found;
+		std::error_code ec;
+		for (fs::directory_iterator it(dir, ec), end; it != end && running; it.increment(ec)) {
+			if (ec || it->path().extension() != ".swml") {
+				continue;
+			}
+
+			MappedFile file;
+			if (!file.Open(it->path().string()) || file.Size() < 8 || std::memcmp(file.Data(), "SWML", 4) != 0 ||
+				Get((const uint8_t *)file.Data() + 4, 4) != Version) {
+				continue;
+			}
+
+			Segment segment;
+			segment.Path = it->path().string();
+
+			uint64_t offset = 8, start = offset;
+			Record record;
+			while (ReadRecord(file.Data(), file.Size(), offset, record)) {
+				if (record.Kind == Keyframe) {
+					segment.Keyframes.emplace_back(record.Time, start);
+				}
+				if (segment.Keyframes.empty()) {
+					break;
+				}
+				segment.Last = record.Time;
+				start = offset;
+			}
+
+			segment.Bytes = start;
+			if (!segment.Keyframes.empty()) {
+				segment.First = segment.Keyframes.front().first;
+				found.push_back(std::move(segment));
+			}
+		}
+
+		std::sort(found.begin(), found.end(), [](const Segment &a, const Segment &b) {
+			return a.First < b.First;
+		});
+
+		std::lock_guard<std::mutex> _(lock);
+		segments = std::move(found);
+	}
+
+	void Run(SnapshotEngine &engine)
+	{
+		std::ofstream out;
+		SnapshotPtr last;
+		uint64_t seq = 0, written = 0;
+		int sinceKeyframe = 0;
+
+		while (running) {
+			if (!engine.IsRunning()) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				continue;
+			}
+
+			auto snapshot = engine.WaitNewer(seq, std::chrono::milliseconds(500));
+			if (!snapshot || snapshot->Seq <= seq) {
+				continue;
+			}
+			seq = snapshot->Seq;
+
+			// nothing to replay, the next good version starts over with a keyframe
+			if (!snapshot->Valid) {
+				last = nullptr;
+				continue;
+			}
+
+			if (!out.is_open() || written >= SegmentBytes) {
+				out.close();
+				if (!Open(out, snapshot->Time)) {
+					continue;
+				}
+				written = 8;
+				last = nullptr;
+			}
+
+			bool keyframe = !last || sinceKeyframe >= KeyframeEvery;
+			auto body = keyframe ? EncodeKeyframe(*snapshot) : EncodeDelta(*last, *snapshot);
+
+			std::string header;
+			Put(header, body.size(), 4);
+			Put(header, deflate::Crc32(body.data(), body.size()), 4);
+			out.write(header.data(), header.size());
+			out.write(body.data(), body.size());
+			out.flush();
+			if (!out) {
+				// disk full or gone, try a new segment with the next version
+				out.close();
+				continue;
+			}
+
+			{
+				std::lock_guard<std::mutex> _(lock);
+				auto &segment = segments.back();
+				if (keyframe) {
+					segment.Keyframes.emplace_back(snapshot->Time, written);
+				}
+				segment.Last = snapshot->Time;
+				written += header.size() + body.size();
+				segment.Bytes = written;
+			}
+
+			sinceKeyframe = keyframe ? 1 : sinceKeyframe + 1;
+			last = snapshot;
+
+			Prune();
+		}
+	}
+
+	// Starts a new segment, the index gets it once its first keyframe is written
+	bool Open(std::ofstream &out, int64_t time)
+	{
+		auto name = std::to_string(time);
+		name.insert(0, name.size() < 16 ? 16 - name.size() : 0, '0');
+		auto path = (std::filesystem::path(dir) / (name + ".swml")).string();
+
+		out.open(path, std::ios::binary | std::ios::trunc);
+		if (!out) {
+			return false;
+		}
+
+		std::string header("SWML", 4);
+		Put(header, Version, 4);
+		out.write(header.data(), header.size());
+		out.flush();
+
+		std::lock_guard<std::mutex> _(lock);
+		Segment segment;
+		segment.Path = path;
+		segment.First = time;
+		segment.Last = time;
+		segment.Bytes = header.size();
+		segments.push_back(std::move(segment));
+		return true;
+	}
+
+	// Deletes the oldest segments while the log is over budget, never the one being written
+	void Prune()
+	{
+		std::lock_guard<std::mutex> _(lock);
+
+		uint64_t total = 0;
+		for (const auto &segment : segments) {
+			total += segment.Bytes;
+		}
+
+		while (total > maxBytes && segments.size() > 1) {
+			std::error_code ec;
+			if (!std::filesystem::remove(segments.front().Path, ec) && ec) {
+				// still mapped by a replay, next time
+				break;
+			}
+			total -= segments.front().Bytes;
+			segments.erase(segments.begin());
+		}
+	}
+
+	std::string dir;
+	uint64_t maxBytes = 0;
+
+	std::atomic<bool> running = false;
+	std::thread worker;
+
+	mutable std::mutex lock;
+	std::vector<Segment> segments; // by First, the last one is being written
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+// World area covered by the map image, the same as setupMap() in main.js and UIWindow::WorldToPixle
+constexpr float MapMinX = -324698.832031f;
+constexpr float MapMaxX = 425301.832031f;
+constexpr float MapMinY = -375e3f;
+constexpr float MapMaxY = 375e3f;
+
+// Uniform grid over the map X/Y, built once per snapshot and shared by every query against it.
+//
+// Cells hold positions into the actor array in CSR form: one offset per cell, then the positions
+// of all cells back to back, ascending within each cell. Actors outside the map are kept in the
+// border cells. A box query reads only the cells it overlaps and tests coordinates only in the
+// cells along its edges, the cells inside it are taken whole.
+class SpatialGrid
+{
+public:
+	static constexpr int Cells = 64; // per side, about 11.7 km
+
+	// one bit per ERepresentationType
+	static constexpr uint64_t AllTypes = ~0ull;
+
+	template <typename Actor>
+	void Build(const std::vector<Actor> &actors)
+	{
+		cellStart.assign(Cells * Cells + 1, 0);
+		for (const auto &actor : actors) {
+			++cellStart[CellOf(actor.Location[0], actor.Location[1]) + 1];
+		}
+		for (int c = 0; c < Cells * Cells; ++c) {
+			cellStart[c + 1] += cellStart[c];
+		}
+
+		items.resize(actors.size());
+		std::vector<uint32_t> next(cellStart.begin(), cellStart.end() - 1);
+		for (uint32_t i = 0; i < (uint32_t)actors.size(); ++i) {
+			items[next[CellOf(actors[i].Location[0], actors[i].Location[1])]++] = i;
+		}
+	}
+
+	// Actors with box[0] <= x <= box[2] and box[1] <= y <= box[3] whose type bit is set in types,
+	// in the order of actors. actors must be what the grid was built from.
+	template <typename Actor>
+	void Query(const std::vector<Actor> &actors, const float box[4], uint64_t types, std::vector<const Actor *> &out) const
+	{
+		out.clear();
+		if (box[0] > box[2] || box[1] > box[3] || items.size() != actors.size()) {
+			return;
+		}
+
+		auto matches = [&](const Actor &actor) {
+			const auto &loc = actor.Location;
+			return loc[0] >= box[0] && loc[1] >= box[1] && loc[0] <= box[2] && loc[1] <= box[3] && HasType(types, actor.Type);
+		};
+
+		const int x0 = Column(box[0]), x1 = Column(box[2]);
+		const int y0 = Row(box[1]), y1 = Row(box[3]);
+
+		// most of the map, walking the cells would only cost the sort
+		if ((x1 - x0 + 1) * (y1 - y0 + 1) * 2 > Cells * Cells) {
+			for (const auto &actor : actors) {
+				if (matches(actor)) {
+					out.push_back(&actor);
+				}
+			}
+			return;
+		}
+
+		for (int y = y0; y <= y1; ++y) {
+			for (int x = x0; x <= x1; ++x) {
+				const int cell = y * Cells + x;
+				const bool edge = x == x0 || x == x1 || y == y0 || y == y1;
+
+				for (uint32_t k = cellStart[cell]; k < cellStart[cell + 1]; ++k) {
+					const auto &actor = actors[items[k]];
+					if (edge ? matches(actor) : HasType(types, actor.Type)) {
+						out.push_back(&actor);
+					}
+				}
+			}
+		}
+
+		std::sort(out.begin(), out.end());
+	}
+
+	static bool HasType(uint64_t types, int type)
+	{
+		return types == AllTypes || (type >= 0 && type < 64 && (types >> type) & 1);
+	}
+
+private:
+	static int Column(float x)
+	{
+		return Clamp((x - MapMinX) * (Cells / (MapMaxX - MapMinX)));
+	}
+
+	static int Row(float y)
+	{
+		return Clamp((y - MapMinY) * (Cells / (MapMaxY - MapMinY)));
+	}
+
+	// NaN ends up in the first cell, the exact test never matches it
+	static int Clamp(float cell)
+	{
+		return cell >= 0.f ? (cell < (float)Cells ? (int)cell : Cells - 1) : 0;
+	}
+
+	static int CellOf(float x, float y)
+	{
+		return Row(y) * Cells + Column(x);
+	}
+
+	std::vector<uint32_t> cellStart;
+	std::vector<uint32_t> items;
+};
@@ -0,0 +1,318 @@
+#pragma once
+
+#include <httplib.h>
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <regex>
+
+#include "Hash.h"
+#include "HttpHelpers.h"
+
+// The web root, read into memory at startup. Text files also keep gzip and deflate
+// copies, so requests never compress anything and never touch the disk.
+//
+// Every file has an ETag from its content. The html and css of the root refer to the other
+// files as name?v=<hash>, and those urls are cached by browsers for a year; the rest revalidate.
+// The table is immutable and swapped whole when a file of the root changes, a request keeps
+// the bodies of the table it started with.
+class StaticFiles
+{
+public:
+	StaticFiles() = default;
+
+	StaticFiles(const StaticFiles &) = delete;
+	StaticFiles &operator=(const StaticFiles &) = delete;
+
+	~StaticFiles()
+	{
+		Stop();
+	}
+
+	// Loads root and starts watching it. Returns false when root is not a directory.
+	bool Load(const std::string &root, int compressionLevel)
+	{
+		Stop();
+
+		auto table = Read(root, compressionLevel);
+		if (!table) {
+			return false;
+		}
+		std::atomic_store(&files, table);
+
+		stopping = false;
+		watcher = std::thread([this, root, compressionLevel] {
+			Watch(root, compressionLevel);
+		});
+		return true;
+	}
+
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> _(m);
+			stopping = true;
+		}
+		wake.notify_all();
+
+		if (watcher.joinable()) {
+			watcher.join();
+		}
+	}
+
+	// Returns false when there is no such file
+	bool Serve(const httplib::Request &req, httplib::Response &res) const
+	{
+		auto path = req.path;
+		if (path.empty() || path.back() == '/') {
+			path += "index.html";
+		}
+
+		auto table = std::atomic_load(&files);
+		if (!table) {
+			return false;
+		}
+
+		auto it = table->find(path);
+		if (it == table->end()) {
+			return false;
+		}
+
+		const auto &file = it->second;
+		auto body = file.Body;
+		auto etag = "\"" + file.Hash;
+
+		if (file.Gzip) {
+			res.set_header("Vary", "Accept-Encoding");
+
+			auto encoding = AcceptedEncoding(req);
+			if (!encoding.empty()) {
+				body = encoding == "gzip" ? file.Gzip : file.Deflate;
+				res.set_header("Content-Encoding", encoding);
+				etag += "-" + encoding;
+			}
+		}
+		etag += "\"";
+
+		// a stale ?v= is still answered, just not cached for long
+		if (req.has_param("v") && req.get_param_value("v") == file.Version) {
+			res.set_header("Cache-Control", "public, max-age=31536000, immutable");
+		} else {
+			res.set_header("Cache-Control", "no-cache");
+		}
+
+		if (NotModified(req, res, etag)) {
+			return true;
+		}
+
+		if (!file.ContentType.empty()) {
+			res.set_header("Content-Type", file.ContentType.c_str());
+		}
+
+		if (body->empty()) {
+			res.set_content("", file.ContentType.c_str());
+			return true;
+		}
+
+		// the response holds the table's body until it is written
+		res.set_content_provider(body->size(), [body](size_t offset, size_t length, httplib::DataSink &sink) {
+			sink.write(body->data() + offset, length);
+			return true;
+		});
+		return true;
+	}
+
+private:
+	struct File
+	{
+		std::string ContentType;
+		std::shared_ptr<const std::string> Body;
+
+		// null when not worth compressing
+		std::shared_ptr<const std::string> Gzip;
+		std::shared_ptr<const std::string> Deflate;
+
+		std::string Hash;    // of Body
+		std::string Version; // ?v= of the references to this file
+	};
+
+	using Table = std::unordered_map<std::string, File>;
+
+	static std::shared_ptr<const Table> Read(const std::string &root, int compressionLevel)
+	{
+		namespace fs = std::filesystem;
+
+		std::error_code ec;
+		if (!fs::is_directory(root, ec)) {
+			return nullptr;
+		}
+
+		auto table = std::make_shared<Table>();
+		std::map<std::string, std::string> bodies;
+		for (fs::recursive_directory_iterator it(root, ec), end; it != end; it.increment(ec)) {
+			if (ec || !it->is_regular_file(ec)) {
+				continue;
+			}
+
+			std::ifstream ifs(it->path(), std::ios::binary);
+			if (!ifs) {
+				continue;
+			}
+
+			std::stringstream ss;
+			ss << ifs.rdbuf();
+
+			bodies["/" + fs::relative(it->path(), root, ec).generic_string()] = ss.str();
+		}
+
+		// the files css refers to, then css, then the html that refers to both
+		auto pass = [](const std::string &path) {
+			auto extension = fs::path(path).extension();
+			return extension == ".css" ? 1 : extension == ".html" || extension == ".htm" ? 2 : 0;
+		};
+		for (int i = 0; i < 3; ++i) {
+			for (const auto &[path, body] : bodies) {
+				if (pass(path) == i) {
+					Add(*table, path, i ? Versioned(path, body, *table) : body, compressionLevel);
+				}
+			}
+		}
+
+		return table;
+	}
+
+	static void Add(Table &table, const std::string &path, const std::string &body, int compressionLevel)
+	{
+		File file;
+		file.Body = std::make_shared<const std::string>(body);
+		file.Hash = HashToHex(Fnv1a64(body));
+		file.Version = file.Hash.substr(0, 8);
+
+		auto type = httplib::detail::find_content_type(path, ExtraTypes());
+		file.ContentType = type ? type : "";
+
+		if (compressionLevel > 0 && Compressible(file.ContentType) && body.size() >= 256) {
+			auto gzip = deflate::Gzip(body, compressionLevel);
+			if (gzip.size() < body.size()) {
+				file.Gzip = std::make_shared<const std::string>(std::move(gzip));
+				file.Deflate = std::make_shared<const std::string>(deflate::Zlib(body, compressionLevel));
+			}
+		}
+
+		table[path] = std::move(file);
+	}
+
+	// Appends ?v=<version> to the src, href and url() of text that name a file of table.
+	// Urls with a scheme, a query or a fragment are left alone.
+	static std::string Versioned(const std::string &path, const std::string &text, const Table &table)
+	{
+		namespace fs = std::filesystem;
+
+		static const std::regex reference(R"re(((?:\b(?:src|href)\s*=\s*["'])|(?:url\(\s*["']?))([^"'()?#:\s]+)(?=["')]))re",
+			std::regex::icase | std::regex::optimize);
+
+		const auto dir = fs::path(path).parent_path();
+
+		std::string out;
+		auto last = text.cbegin();
+		for (std::sregex_iterator it(text.begin(), text.end(), reference), end; it != end; ++it) {
+			const auto &match = *it;
+			auto url = match[2].str();
+
+			auto target = url[0] == '/' ? fs::path(url) : dir / url;
+			auto found = url.compare(0, 2, "//") ? table.find(target.lexically_normal().generic_string()) : table.end();
+			if (found == table.end()) {
+				continue;
+			}
+
+			out.append(last, match[2].second);
+			out += "?v=" + found->second.Version;
+			last = match[2].second;
+		}
+		out.append(last, text.cend());
+		return out;
+	}
+
+	// Size and time of every file under root, changes when any of them does
+	static uint64_t Signature(const std::string &root)
+	{
+		namespace fs = std::filesystem;
+
+		uint64_t hash = FNV64Offset;
+		std::error_code ec;
+		for (fs::recursive_directory_iterator it(root, ec), end; it != end; it.increment(ec)) {
+			if (ec || !it->is_regular_file(ec)) {
+				continue;
+			}
+
+			auto name = it->path().generic_string();
+			auto size = (uint64_t)it->file_size(ec);
+			auto time = (int64_t)it->last_write_time(ec).time_since_epoch().count();
+
+			hash = Fnv1a64(name, hash);
+			hash = Fnv1a64(&size, sizeof(size), hash);
+			hash = Fnv1a64(&time, sizeof(time), hash);
+		}
+		return hash;
+	}
+
+	void Watch(const std::string &root, int compressionLevel)
+	{
+		auto signature = Signature(root);
+
+		std::unique_lock<std::mutex> lock(m);
+		while (!wake.wait_for(lock, std::chrono::seconds(2), [this] { return stopping; })) {
+			lock.unlock();
+
+			auto current = Signature(root);
+			if (current != signature) {
+				// an editor may still be writing, the next change reloads again
+				if (auto table = Read(root, compressionLevel)) {
+					std::atomic_store(&files, table);
+				}
+				signature = current;
+			}
+
+			lock.lock();
+		}
+	}
+
+	// types httplib does not know, mostly the icon fonts
+	static const std::map<std::string, std::string> &ExtraTypes()
+	{
+		static const std::map<std::string, std::string> types = {
+			{ "woff", "font/woff" },
+			{ "woff2", "font/woff2" },
+			{ "ttf", "font/ttf" },
+			{ "eot", "application/vnd.ms-fontobject" },
+		};
+		return types;
+	}
+
+	static bool Compressible(const std::string &type)
+	{
+		return !type.find("text/") || type == "image/svg+xml" ||
+			type == "application/javascript" ||
+			type == "application/json" ||
+			type == "application/xml" ||
+			type == "application/xhtml+xml" ||
+			type == "font/ttf" || type == "application/vnd.ms-fontobject";
+	}
+
+	std::shared_ptr<const Table> files;
+
+	std::thread watcher;
+	std::mutex m;
+	std::condition_variable wake;
+	bool stopping = false;
+};
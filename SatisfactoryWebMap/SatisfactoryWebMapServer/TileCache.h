@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Encoded tiles by content hash, least recently used dropped first once the bodies
+// add up to more than the byte budget. Bodies are shared, never copied.
+class TileCache
+{
+public:
+	explicit TileCache(size_t maxBytes) : maxBytes(maxBytes)
+	{}
+
+	// The body stored for key, built by build() and stored when there is none
+	template <typename Build>
+	std::shared_ptr<const std::string> Get(uint64_t key, Build build)
+	{
+		{
+			std::lock_guard<std::mutex> _(m);
+			auto it = entries.find(key);
+			if (it != entries.end()) {
+				order.splice(order.begin(), order, it->second.Position);
+				return it->second.Body;
+			}
+		}
+
+		// built outside the lock, two requests for the same new tile may both build it
+		auto body = std::make_shared<const std::string>(build());
+
+		std::lock_guard<std::mutex> _(m);
+		if (entries.count(key) == 0) {
+			order.push_front(key);
+			entries[key] = { body, order.begin() };
+			bytes += body->size();
+
+			while (bytes > maxBytes && order.size() > 1) {
+				auto last = entries.find(order.back());
+				bytes -= last->second.Body->size();
+				entries.erase(last);
+				order.pop_back();
+			}
+		}
+		return body;
+	}
+
+private:
+	struct Entry
+	{
+		std::shared_ptr<const std::string> Body;
+		std::list<uint64_t>::iterator Position;
+	};
+
+	std::mutex m;
+	std::unordered_map<uint64_t, Entry> entries;
+	std::list<uint64_t> order; // most recently used first
+
+	size_t maxBytes;
+	size_t bytes = 0;
+};
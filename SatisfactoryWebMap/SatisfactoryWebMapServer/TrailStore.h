@@ -0,0 +1,508 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Snapshot.h"
+
+// Where the moving actors have been, for /api/history. One trail per InternalIndex.
+//
+// Positions are kept to the metre and times to a tenth of a second. Samples are only stored where the
+// trail bends: as long as a straight line from the last stored sample passes within Tolerance of
+// every sample since, they are skipped, so actors standing still or going straight cost nothing. The
+// newest sample is always kept aside as the end of the trail. Stored samples are delta-of-delta
+// coded, time and position against the line through the two before, into Gorilla style variable
+// bit fields of 1 to 36 bits.
+//
+// Every trail is a ring of at most MaxBlocks blocks of BlockBytes, the oldest block is dropped when
+// a new one is needed or once it is older than Retention. Each block starts from a plain sample and
+// decodes on its own, and keeps the bounding box of its samples for bbox queries.
+class TrailStore
+{
+public:
+	static constexpr int32_t Resolution = 100; // world units per position step, 1 m
+	static constexpr int32_t TimeStep = 100;   // ms per time step
+	static constexpr int32_t Tolerance = 1;    // steps a skipped sample may be off the line
+
+	static constexpr size_t BlockBytes = 1024;
+	static constexpr size_t MaxBlocks = 32; // 32 KB per actor at most
+	static constexpr int64_t Retention = 24 * 3600 * 1000;
+
+	struct Point
+	{
+		int64_t Time; // unix time in ms
+		float Location[3];
+	};
+
+	struct Trail
+	{
+		int32_t Index;
+		int8_t Type;
+		std::vector<Point> Points;
+	};
+
+	explicit TrailStore(bool recordStatic = false) : recordStatic(recordStatic)
+	{}
+
+	TrailStore(const TrailStore &) = delete;
+	TrailStore &operator=(const TrailStore &) = delete;
+
+	~TrailStore()
+	{
+		Stop();
+	}
+
+	// Records every version engine publishes, on a thread of its own so the snapshot thread never waits
+	void Follow(SnapshotEngine &engine)
+	{
+		Stop();
+		following = true;
+
+		worker = std::thread([this, &engine] {
+			uint64_t seq = 0;
+			while (following) {
+				if (!engine.IsRunning()) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(100));
+					continue;
+				}
+
+				auto snapshot = engine.WaitNewer(seq, std::chrono::milliseconds(500));
+				if (snapshot && snapshot->Seq > seq) {
+					seq = snapshot->Seq;
+					if (snapshot->Valid) {
+						Record(*snapshot);
+					}
+				}
+			}
+		});
+	}
+
+	void Stop()
+	{
+		following = false;
+		if (worker.joinable()) {
+			worker.join();
+		}
+	}
+
+	// Adds the actors of snapshot, static ones only when asked to
+	void Record(const Snapshot &snapshot)
+	{
+		std::unique_lock<std::shared_mutex> _(lock);
+
+		for (const auto &actor : snapshot.Actors) {
+			if ((actor.IsStatic && !recordStatic) || !std::isfinite(actor.Location[0]) || !std::isfinite(actor.Location[1]) ||
+				!std::isfinite(actor.Location[2])) {
+				continue;
+			}
+
+			auto &track = tracks[actor.Index];
+			track.Type = actor.Type;
+			track.Add(ToSample(snapshot.Time, actor.Location));
+		}
+
+		// gone actors keep their trail until it expires
+		const int64_t cutoff = ToTime(snapshot.Time - Retention);
+		for (auto it = tracks.begin(); it != tracks.end();) {
+			if (it->second.Expire(cutoff)) {
+				it = tracks.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	// Trail of one actor since a unix time in ms, false when there is none
+	bool Get(int32_t index, int64_t since, Trail &out) const
+	{
+		std::shared_lock<std::shared_mutex> _(lock);
+
+		auto it = tracks.find(index);
+		if (it == tracks.end()) {
+			return false;
+		}
+
+		out.Index = index;
+		out.Type = it->second.Type;
+		out.Points.clear();
+		it->second.Decode(ToTime(since), out.Points);
+		return true;
+	}
+
+	// Trails of every actor that was in box since a unix time in ms, in Index order
+	void Find(const float box[4], int64_t since, std::vector<Trail> &out) const
+	{
+		const int32_t area[4] = {
+			ToStep(box[0]) - 1, ToStep(box[1]) - 1, ToStep(box[2]) + 1, ToStep(box[3]) + 1,
+		};
+		const int64_t from = ToTime(since);
+
+		out.clear();
+
+		std::shared_lock<std::shared_mutex> _(lock);
+		for (const auto &[index, track] : tracks) {
+			if (!track.Touches(area, from)) {
+				continue;
+			}
+
+			out.push_back({ index, track.Type, {} });
+			track.Decode(from, out.back().Points);
+		}
+
+		std::sort(out.begin(), out.end(), [](const Trail &a, const Trail &b) {
+			return a.Index < b.Index;
+		});
+	}
+
+	// memory held by the trails
+	size_t Bytes() const
+	{
+		std::shared_lock<std::shared_mutex> _(lock);
+
+		size_t bytes = 0;
+		for (const auto &entry : tracks) {
+			bytes += sizeof(entry) + sizeof(Block) * entry.second.Blocks.size();
+			for (const auto &block : entry.second.Blocks) {
+				bytes += block.Data.capacity();
+			}
+		}
+		return bytes;
+	}
+
+	size_t Size() const
+	{
+		std::shared_lock<std::shared_mutex> _(lock);
+		return tracks.size();
+	}
+
+private:
+	// time and position in steps
+	struct Sample
+	{
+		int64_t Time;
+		int32_t Pos[3];
+	};
+
+	static int32_t ToStep(float v)
+	{
+		return (int32_t)std::llround((std::min)((std::max)((double)v, -1e9), 1e9) / Resolution);
+	}
+
+	static int64_t ToTime(int64_t ms)
+	{
+		return ms / TimeStep;
+	}
+
+	static Sample ToSample(int64_t time, const float location[3])
+	{
+		return { ToTime(time), { ToStep(location[0]), ToStep(location[1]), ToStep(location[2]) } };
+	}
+
+	static Point ToPoint(const Sample &sample)
+	{
+		return { sample.Time * TimeStep, {
+			(float)sample.Pos[0] * Resolution, (float)sample.Pos[1] * Resolution, (float)sample.Pos[2] * Resolution,
+		} };
+	}
+
+	// where the line through prev and last is at time, last when they are at the same time
+	static int64_t Predict(const Sample &prev, const Sample &last, int64_t time, int axis)
+	{
+		if (last.Time <= prev.Time) {
+			return last.Pos[axis];
+		}
+		return last.Pos[axis] + ((int64_t)last.Pos[axis] - prev.Pos[axis]) * (time - last.Time) / (last.Time - prev.Time);
+	}
+
+	// '0' for 0, then 4, 9, 16 and 32 bit fields after a 2 to 4 bit prefix
+	static constexpr size_t MaxFieldBits = 4 + 32;
+	static constexpr size_t MaxSampleBits = 4 * MaxFieldBits;
+
+	struct Block
+	{
+		Sample Before; // stored sample before Start, Start itself for the first block
+		Sample Start;
+		int64_t LastTime;
+		int32_t Min[2], Max[2]; // bounding box in steps, with Before
+
+		uint32_t Count = 1;
+		size_t Bits = 0;
+		std::vector<uint8_t> Data;
+
+		void Extend(const Sample &sample)
+		{
+			for (int i = 0; i < 2; ++i) {
+				Min[i] = (std::min)(Min[i], sample.Pos[i]);
+				Max[i] = (std::max)(Max[i], sample.Pos[i]);
+			}
+			LastTime = sample.Time;
+		}
+
+		void Put(uint64_t value, int bits)
+		{
+			for (int i = bits - 1; i >= 0; --i) {
+				if (Bits % 8 == 0) {
+					Data.push_back(0);
+				}
+				if ((value >> i) & 1) {
+					Data.back() |= (uint8_t)(0x80 >> (Bits % 8));
+				}
+				++Bits;
+			}
+		}
+
+		void PutField(int64_t v)
+		{
+			if (v == 0) {
+				Put(0, 1);
+			} else if (v >= -8 && v < 8) {
+				Put(0b10, 2);
+				Put((uint64_t)v, 4);
+			} else if (v >= -256 && v < 256) {
+				Put(0b110, 3);
+				Put((uint64_t)v, 9);
+			} else if (v >= -32768 && v < 32768) {
+				Put(0b1110, 4);
+				Put((uint64_t)v, 16);
+			} else {
+				Put(0b1111, 4);
+				Put((uint64_t)(int64_t)(int32_t)v, 32);
+			}
+		}
+
+		uint64_t Take(size_t &bit, int bits) const
+		{
+			uint64_t value = 0;
+			for (int i = 0; i < bits; ++i, ++bit) {
+				value = (value << 1) | ((Data[bit / 8] >> (7 - bit % 8)) & 1);
+			}
+			return value;
+		}
+
+		int64_t TakeField(size_t &bit) const
+		{
+			int prefix = 0;
+			while (prefix < 4 && Take(bit, 1)) {
+				++prefix;
+			}
+
+			static const int widths[5] = { 0, 4, 9, 16, 32 };
+			int width = widths[prefix];
+			if (width == 0) {
+				return 0;
+			}
+
+			// sign extend
+			auto raw = Take(bit, width);
+			return (int64_t)(raw << (64 - width)) >> (64 - width);
+		}
+	};
+
+	struct Track
+	{
+		int8_t Type = 0;
+		std::deque<Block> Blocks;
+
+		// the last two stored samples, the predictor of the coding
+		Sample Prev{}, Last{};
+		int64_t LastDelta = 0;
+		bool HasLast = false;
+
+		// newest sample, not stored while the line from Last to it passes every skipped one
+		Sample Pending{};
+		bool HasPending = false;
+
+		// slopes from Last, in steps per time step, that pass within Tolerance of every skipped sample
+		double Low[3], High[3];
+
+		void Open()
+		{
+			for (int i = 0; i < 3; ++i) {
+				Low[i] = -HUGE_VAL;
+				High[i] = HUGE_VAL;
+			}
+		}
+
+		bool Passes(const Sample &sample) const
+		{
+			const double dt = (double)(sample.Time - Last.Time);
+			for (int i = 0; i < 3; ++i) {
+				double slope = (sample.Pos[i] - Last.Pos[i]) / dt;
+				if (slope < Low[i] || slope > High[i]) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		void Narrow(const Sample &sample)
+		{
+			const double dt = (double)(sample.Time - Last.Time);
+			for (int i = 0; i < 3; ++i) {
+				Low[i] = (std::max)(Low[i], (sample.Pos[i] - Tolerance - Last.Pos[i]) / dt);
+				High[i] = (std::min)(High[i], (sample.Pos[i] + Tolerance - Last.Pos[i]) / dt);
+			}
+		}
+
+		// A swinging door: the trail bends at the last sample before the line from Last has to leave
+		// the tolerance of a skipped one
+		void Add(const Sample &sample)
+		{
+			if (!HasLast) {
+				Store(sample);
+				Open();
+				return;
+			}
+
+			if (sample.Time <= (HasPending ? Pending.Time : Last.Time)) {
+				return;
+			}
+
+			if (HasPending && !Passes(sample)) {
+				Store(Pending);
+				Open();
+			}
+
+			Narrow(sample);
+			Pending = sample;
+			HasPending = true;
+		}
+
+		void Store(const Sample &sample)
+		{
+			int64_t residual[3] = {};
+			bool fits = HasLast;
+			for (int i = 0; i < 3 && fits; ++i) {
+				residual[i] = sample.Pos[i] - Predict(Prev, Last, sample.Time, i);
+				fits = residual[i] >= INT32_MIN && residual[i] <= INT32_MAX;
+			}
+
+			// a block also starts over after a jump the fields cannot hold
+			if (!fits || Blocks.empty() || Blocks.back().Bits + MaxSampleBits > BlockBytes * 8) {
+				if (Blocks.size() >= MaxBlocks) {
+					Blocks.pop_front();
+				}
+
+				Blocks.emplace_back();
+				auto &block = Blocks.back();
+				block.Before = HasLast ? Last : sample;
+				block.Start = sample;
+				for (int i = 0; i < 2; ++i) {
+					block.Min[i] = block.Max[i] = block.Before.Pos[i];
+				}
+				block.Extend(sample);
+
+				LastDelta = HasLast ? sample.Time - Last.Time : 0;
+				Prev = HasLast ? Last : sample;
+				Last = sample;
+				HasLast = true;
+				return;
+			}
+
+			auto &block = Blocks.back();
+			if (block.Data.empty()) {
+				block.Data.reserve(BlockBytes);
+			}
+
+			auto delta = sample.Time - Last.Time;
+			block.PutField(delta - LastDelta);
+			for (auto v : residual) {
+				block.PutField(v);
+			}
+			block.Extend(sample);
+			++block.Count;
+
+			LastDelta = delta;
+			Prev = Last;
+			Last = sample;
+		}
+
+		// Drops the blocks older than cutoff, true when nothing newer is left
+		bool Expire(int64_t cutoff)
+		{
+			if ((HasPending ? Pending.Time : Last.Time) < cutoff) {
+				return true;
+			}
+
+			// the newest block is still written to
+			while (Blocks.size() > 1 && Blocks.front().LastTime < cutoff) {
+				Blocks.pop_front();
+			}
+			return false;
+		}
+
+		bool Touches(const int32_t area[4], int64_t from) const
+		{
+			for (const auto &block : Blocks) {
+				if (block.LastTime >= from && block.Min[0] <= area[2] && block.Max[0] >= area[0] &&
+					block.Min[1] <= area[3] && block.Max[1] >= area[1]) {
+					return true;
+				}
+			}
+
+			// the straight run to the pending sample
+			if (HasPending && Pending.Time >= from) {
+				for (int i = 0; i < 2; ++i) {
+					if ((std::max)(Last.Pos[i], Pending.Pos[i]) < area[i] || (std::min)(Last.Pos[i], Pending.Pos[i]) > area[i + 2]) {
+						return false;
+					}
+				}
+				return true;
+			}
+			return false;
+		}
+
+		void Decode(int64_t from, std::vector<Point> &out) const
+		{
+			for (const auto &block : Blocks) {
+				if (block.LastTime < from) {
+					continue;
+				}
+
+				Sample prev = block.Before, last = block.Start;
+				int64_t delta = last.Time - prev.Time;
+				if (last.Time >= from) {
+					out.push_back(ToPoint(last));
+				}
+
+				size_t bit = 0;
+				for (uint32_t n = 1; n < block.Count; ++n) {
+					Sample sample;
+					delta += block.TakeField(bit);
+					sample.Time = last.Time + delta;
+					for (int i = 0; i < 3; ++i) {
+						sample.Pos[i] = (int32_t)(Predict(prev, last, sample.Time, i) + block.TakeField(bit));
+					}
+
+					if (sample.Time >= from) {
+						out.push_back(ToPoint(sample));
+					}
+					prev = last;
+					last = sample;
+				}
+			}
+
+			if (HasPending && Pending.Time >= from) {
+				out.push_back(ToPoint(Pending));
+			}
+		}
+	};
+
+	bool recordStatic;
+
+	mutable std::shared_mutex lock;
+	std::unordered_map<int32_t, Track> tracks;
+
+	std::atomic<bool> following = false;
+	std::thread worker;
+};
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "Snapshot.h"
+
+// Mapbox Vector Tiles (MVT 2.1) of the actor layer, written with a minimal protobuf encoder.
+//
+// Tiles follow the CRS.Simple projection of main.js: worldToMap() puts world (x, y) at
+// latLng(-y, x), so at zoom z a world point is at pixel (x * 2^z, y * 2^z) and tile (tx, ty)
+// covers pixels [tx * 256, tx * 256 + 256) x [ty * 256, ty * 256 + 256). Tile numbers are
+// negative left of and above the world origin.
+namespace mvt {
+
+constexpr int TileSize = 256; // pixels
+constexpr uint32_t Extent = 4096; // tile coordinates per side
+constexpr int Buffer = 16; // pixels around the tile, so markers on an edge are drawn in both tiles
+
+constexpr int MinZoom = -12;
+constexpr int MaxZoom = -2;
+
+// World box of a tile including the buffer: minX, minY, maxX, maxY
+inline void TileBounds(int z, int x, int y, float box[4])
+{
+	double size = std::ldexp((double)TileSize, -z), buffer = std::ldexp((double)Buffer, -z);
+	box[0] = (float)(x * size - buffer);
+	box[1] = (float)(y * size - buffer);
+	box[2] = (float)((x + 1) * size + buffer);
+	box[3] = (float)((y + 1) * size + buffer);
+}
+
+// Appends protobuf wire format to a string
+class ProtobufWriter
+{
+public:
+	explicit ProtobufWriter(std::string &out) : out(out)
+	{}
+
+	void Varint(uint64_t v)
+	{
+		while (v >= 0x80) {
+			out += (char)(v | 0x80);
+			v >>= 7;
+		}
+		out += (char)v;
+	}
+
+	static uint32_t ZigZag(int32_t v)
+	{
+		return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+	}
+
+	void Tag(int field, int wireType)
+	{
+		Varint(((uint64_t)field << 3) | wireType);
+	}
+
+	void UInt(int field, uint64_t v)
+	{
+		Tag(field, 0);
+		Varint(v);
+	}
+
+	void Bytes(int field, const std::string &bytes)
+	{
+		Tag(field, 2);
+		Varint(bytes.size());
+		out += bytes;
+	}
+
+	void Packed(int field, const std::vector<uint32_t> &values)
+	{
+		std::string packed;
+		ProtobufWriter(packed).Varints(values);
+		Bytes(field, packed);
+	}
+
+	void Varints(const std::vector<uint32_t> &values)
+	{
+		for (auto v : values) {
+			Varint(v);
+		}
+	}
+
+private:
+	std::string &out;
+};
+
+// Layer "actors", one point per actor with id = index and the properties index and type.
+// Actors outside the tile and its buffer are skipped.
+inline std::string EncodeActorTile(int z, int x, int y, const std::vector<const ActorState *> &actors)
+{
+	enum { KeyIndex, KeyType };
+	const double scale = std::ldexp(1., z) * (Extent / TileSize);
+	const double originX = (double)x * Extent, originY = (double)y * Extent;
+	const double limit = (double)Buffer * (Extent / TileSize);
+
+	// values table: every distinct index and type once, in order of first use
+	std::string values;
+	std::vector<uint32_t> typeValue(256, UINT32_MAX);
+	uint32_t valueCount = 0;
+
+	std::string features, feature, value;
+	std::vector<uint32_t> tags, geometry;
+
+	for (const auto *actor : actors) {
+		double px = actor->Location[0] * scale - originX;
+		double py = actor->Location[1] * scale - originY;
+		if (!(px >= -limit && py >= -limit && px < Extent + limit && py < Extent + limit)) {
+			continue;
+		}
+
+		// indices are unique, so each gets its own value
+		value.clear();
+		ProtobufWriter(value).UInt(4, (uint64_t)(int64_t)actor->Index); // int_value
+		ProtobufWriter(values).Bytes(4, value);
+		uint32_t indexValue = valueCount++;
+
+		auto &type = typeValue[(uint8_t)actor->Type];
+		if (type == UINT32_MAX) {
+			value.clear();
+			ProtobufWriter(value).UInt(5, (uint8_t)actor->Type); // uint_value
+			ProtobufWriter(values).Bytes(4, value);
+			type = valueCount++;
+		}
+
+		tags = { KeyIndex, indexValue, KeyType, type };
+		geometry = { (1 << 3) | 1, ProtobufWriter::ZigZag((int32_t)std::floor(px)), ProtobufWriter::ZigZag((int32_t)std::floor(py)) }; // MoveTo(1)
+
+		feature.clear();
+		ProtobufWriter f(feature);
+		f.UInt(1, (uint64_t)actor->Index); // id
+		f.Packed(2, tags);
+		f.UInt(3, 1); // POINT
+		f.Packed(4, geometry);
+
+		ProtobufWriter(features).Bytes(2, feature);
+	}
+
+	std::string layer;
+	ProtobufWriter l(layer);
+	l.UInt(15, 2); // version
+	l.Bytes(1, "actors");
+	layer += features;
+	l.Bytes(3, "index");
+	l.Bytes(3, "type");
+	layer += values;
+	l.UInt(5, Extent);
+
+	std::string tile;
+	if (valueCount > 0) {
+		ProtobufWriter(tile).Bytes(3, layer);
+	}
+	return tile;
+}
+
+}
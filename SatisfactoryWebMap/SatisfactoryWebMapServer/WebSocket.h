@@ -0,0 +1,549 @@
+#pragma once
+
+#include <httplib.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <algorithm>
+
+// Minimal RFC 6455 server. httplib has no upgrade path, so this listens on its own port
+// and runs one thread per connection.
+
+namespace websocket {
+
+// SHA-1, only used for Sec-WebSocket-Accept
+inline std::string Sha1(const std::string &input)
+{
+	uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+	std::string msg = input;
+	uint64_t bits = (uint64_t)input.size() * 8;
+	msg += (char)0x80;
+	while (msg.size() % 64 != 56) {
+		msg += (char)0;
+	}
+	for (int i = 7; i >= 0; --i) {
+		msg += (char)((bits >> (i * 8)) & 0xff);
+	}
+
+	auto rol = [](uint32_t v, int n) { return (v << n) | (v >> (32 - n)); };
+
+	for (size_t chunk = 0; chunk < msg.size(); chunk += 64) {
+		uint32_t w[80];
+		for (int i = 0; i < 16; ++i) {
+			auto p = (const uint8_t *)msg.data() + chunk + i * 4;
+			w[i] = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+		}
+		for (int i = 16; i < 80; ++i) {
+			w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+		}
+
+		uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+		for (int i = 0; i < 80; ++i) {
+			uint32_t f, k;
+			if (i < 20) {
+				f = (b & c) | (~b & d);
+				k = 0x5A827999;
+			} else if (i < 40) {
+				f = b ^ c ^ d;
+				k = 0x6ED9EBA1;
+			} else if (i < 60) {
+				f = (b & c) | (b & d) | (c & d);
+				k = 0x8F1BBCDC;
+			} else {
+				f = b ^ c ^ d;
+				k = 0xCA62C1D6;
+			}
+
+			uint32_t t = rol(a, 5) + f + e + k + w[i];
+			e = d;
+			d = c;
+			c = rol(b, 30);
+			b = a;
+			a = t;
+		}
+
+		h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+	}
+
+	std::string out;
+	for (auto v : h) {
+		for (int i = 3; i >= 0; --i) {
+			out += (char)((v >> (i * 8)) & 0xff);
+		}
+	}
+	return out;
+}
+
+inline std::string Base64Encode(const std::string &input)
+{
+	static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	std::string out;
+	size_t i = 0;
+	for (; i + 2 < input.size(); i += 3) {
+		uint32_t v = (uint8_t)input[i] << 16 | (uint8_t)input[i + 1] << 8 | (uint8_t)input[i + 2];
+		out += table[(v >> 18) & 63];
+		out += table[(v >> 12) & 63];
+		out += table[(v >> 6) & 63];
+		out += table[v & 63];
+	}
+
+	if (i < input.size()) {
+		uint32_t v = (uint8_t)input[i] << 16;
+		if (i + 1 < input.size()) {
+			v |= (uint8_t)input[i + 1] << 8;
+		}
+
+		out += table[(v >> 18) & 63];
+		out += table[(v >> 12) & 63];
+		out += i + 1 < input.size() ? table[(v >> 6) & 63] : '=';
+		out += '=';
+	}
+	return out;
+}
+
+inline std::string AcceptKey(const std::string &key)
+{
+	return Base64Encode(Sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"));
+}
+
+}
+
+class WebSocketConnection
+{
+public:
+	enum Opcode : uint8_t
+	{
+		OpContinuation = 0x0,
+		OpText = 0x1,
+		OpBinary = 0x2,
+		OpClose = 0x8,
+		OpPing = 0x9,
+		OpPong = 0xA,
+	};
+
+	// larger client messages close the connection
+	static constexpr size_t MaxMessageSize = 64 * 1024;
+
+	explicit WebSocketConnection(socket_t sock) : sock(sock)
+	{}
+
+	WebSocketConnection(const WebSocketConnection &) = delete;
+	WebSocketConnection &operator=(const WebSocketConnection &) = delete;
+
+	// Reads the HTTP upgrade request and answers it, path receives the request target
+	bool Handshake(std::string &path)
+	{
+		std::string request;
+		char buf[1024];
+
+		while (request.find("\r\n\r\n") == std::string::npos) {
+			if (request.size() > 8192 || httplib::detail::select_read(sock, 5, 0) <= 0) {
+				return false;
+			}
+
+			auto n = recv(sock, buf, sizeof(buf), 0);
+			if (n <= 0) {
+				return false;
+			}
+			request.append(buf, (size_t)n);
+		}
+
+		if (request.compare(0, 4, "GET ") != 0) {
+			return false;
+		}
+		path = request.substr(4, request.find(' ', 4) - 4);
+
+		std::string key;
+		bool upgrade = false;
+
+		size_t pos = request.find("\r\n") + 2;
+		while (pos < request.size()) {
+			auto eol = request.find("\r\n", pos);
+			auto line = request.substr(pos, eol - pos);
+			pos = eol + 2;
+
+			auto colon = line.find(':');
+			if (colon == std::string::npos) {
+				continue;
+			}
+
+			auto name = line.substr(0, colon);
+			auto value = line.substr((std::min)(line.find_first_not_of(' ', colon + 1), line.size()));
+			std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+			if (name == "sec-websocket-key") {
+				key = value;
+			} else if (name == "upgrade") {
+				std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+				upgrade = value == "websocket";
+			}
+		}
+
+		if (!upgrade || key.empty()) {
+			static const std::string bad = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+			WriteAll(bad.data(), bad.size());
+			return false;
+		}
+
+		auto response = "HTTP/1.1 101 Switching Protocols\r\n"
+			"Upgrade: websocket\r\n"
+			"Connection: Upgrade\r\n"
+			"Sec-WebSocket-Accept: " + websocket::AcceptKey(key) + "\r\n\r\n";
+
+		return WriteAll(response.data(), response.size());
+	}
+
+	// Waits up to timeoutMs for the next data message, answering pings on the way.
+	// Returns false once the connection is closed, got tells whether message was filled.
+	bool Poll(int timeoutMs, std::string &message, bool &binary, bool &got)
+	{
+		got = false;
+
+		while (open) {
+			auto ready = httplib::detail::select_read(sock, timeoutMs / 1000, (timeoutMs % 1000) * 1000);
+			if (ready < 0) {
+				open = false;
+				break;
+			}
+			if (ready == 0) {
+				return true;
+			}
+
+			uint8_t header[2];
+			if (!ReadAll(header, 2)) {
+				open = false;
+				break;
+			}
+
+			bool fin = header[0] & 0x80;
+			uint8_t opcode = header[0] & 0x0f;
+			bool masked = header[1] & 0x80;
+			uint64_t len = header[1] & 0x7f;
+
+			if (len == 126) {
+				uint8_t ext[2];
+				if (!ReadAll(ext, 2)) {
+					open = false;
+					break;
+				}
+				len = (uint64_t)ext[0] << 8 | ext[1];
+			} else if (len == 127) {
+				uint8_t ext[8];
+				if (!ReadAll(ext, 8)) {
+					open = false;
+					break;
+				}
+				len = 0;
+				for (auto b : ext) {
+					len = len << 8 | b;
+				}
+			}
+
+			// clients must mask; len can be anything up to 2^64, keep the sum from wrapping
+			if (!masked || len > MaxMessageSize || len > MaxMessageSize - fragments.size()) {
+				Close(1009);
+				break;
+			}
+
+			uint8_t mask[4];
+			std::string payload((size_t)len, '\0');
+			if (!ReadAll(mask, 4) || !ReadAll(&payload[0], payload.size())) {
+				open = false;
+				break;
+			}
+			for (size_t i = 0; i < payload.size(); ++i) {
+				payload[i] ^= mask[i % 4];
+			}
+
+			switch (opcode) {
+			case OpPing:
+				SendFrame(OpPong, payload.data(), payload.size());
+				break;
+			case OpPong:
+				break;
+			case OpClose:
+				Close(1000);
+				break;
+			case OpText:
+			case OpBinary:
+			case OpContinuation:
+				if (opcode != OpContinuation) {
+					fragments.clear();
+					fragmentOpcode = opcode;
+				}
+				fragments += payload;
+
+				if (fin) {
+					message = std::move(fragments);
+					binary = fragmentOpcode == OpBinary;
+					fragments.clear();
+					got = true;
+					return true;
+				}
+				break;
+			default:
+				Close(1002);
+				break;
+			}
+
+			// keep draining what already arrived, but do not wait again
+			timeoutMs = 0;
+		}
+
+		return false;
+	}
+
+	bool SendText(const std::string &text)
+	{
+		return SendFrame(OpText, text.data(), text.size());
+	}
+
+	bool SendBinary(const void *data, size_t len)
+	{
+		return SendFrame(OpBinary, data, len);
+	}
+
+	void Close(uint16_t code = 1000)
+	{
+		if (open) {
+			uint8_t payload[2] = { (uint8_t)(code >> 8), (uint8_t)(code & 0xff) };
+			SendFrame(OpClose, payload, sizeof(payload));
+			open = false;
+		}
+	}
+
+	bool IsOpen() const
+	{
+		return open;
+	}
+
+private:
+	bool SendFrame(uint8_t opcode, const void *data, size_t len)
+	{
+		if (!open) {
+			return false;
+		}
+
+		uint8_t header[10];
+		size_t headerLen = 2;
+
+		header[0] = 0x80 | opcode;
+		if (len < 126) {
+			header[1] = (uint8_t)len;
+		} else if (len <= 0xffff) {
+			header[1] = 126;
+			header[2] = (uint8_t)(len >> 8);
+			header[3] = (uint8_t)(len & 0xff);
+			headerLen = 4;
+		} else {
+			header[1] = 127;
+			for (int i = 0; i < 8; ++i) {
+				header[2 + i] = (uint8_t)(((uint64_t)len >> ((7 - i) * 8)) & 0xff);
+			}
+			headerLen = 10;
+		}
+
+		if (!WriteAll(header, headerLen) || !WriteAll(data, len)) {
+			open = false;
+			return false;
+		}
+		return true;
+	}
+
+	bool ReadAll(void *dst, size_t len)
+	{
+		auto p = (char *)dst;
+		while (len > 0) {
+			if (httplib::detail::select_read(sock, 5, 0) <= 0) {
+				return false;
+			}
+
+			auto n = recv(sock, p, (int)std::min<size_t>(len, 1 << 20), 0);
+			if (n <= 0) {
+				return false;
+			}
+			p += n;
+			len -= (size_t)n;
+		}
+		return true;
+	}
+
+	bool WriteAll(const void *src, size_t len)
+	{
+		auto p = (const char *)src;
+		while (len > 0) {
+			if (httplib::detail::select_write(sock, 5, 0) <= 0) {
+				return false;
+			}
+
+			auto n = send(sock, p, (int)std::min<size_t>(len, 1 << 20), 0);
+			if (n <= 0) {
+				return false;
+			}
+			p += n;
+			len -= (size_t)n;
+		}
+		return true;
+	}
+
+	socket_t sock;
+	bool open = true;
+
+	std::string fragments;
+	uint8_t fragmentOpcode = OpText;
+};
+
+class WebSocketServer
+{
+public:
+	using Handler = std::function<void(WebSocketConnection &ws, const std::string &path)>;
+
+	WebSocketServer() = default;
+	WebSocketServer(const WebSocketServer &) = delete;
+	WebSocketServer &operator=(const WebSocketServer &) = delete;
+
+	~WebSocketServer()
+	{
+		Stop();
+	}
+
+	bool Listen(const std::string &host, int port, int maxConnections, Handler handler)
+	{
+		Stop();
+
+		listenSock = httplib::detail::create_socket(host.c_str(), port, AI_PASSIVE, nullptr,
+			[](socket_t sock, struct addrinfo &ai) -> bool {
+				if (::bind(sock, ai.ai_addr, static_cast<socklen_t>(ai.ai_addrlen))) {
+					return false;
+				}
+				return ::listen(sock, 5) == 0;
+			});
+
+		if (listenSock == INVALID_SOCKET) {
+			return false;
+		}
+
+		this->handler = std::move(handler);
+		this->maxConnections = maxConnections;
+		running = true;
+
+		acceptThread = std::thread([this] { AcceptLoop(); });
+		return true;
+	}
+
+	void Stop()
+	{
+		if (!running) {
+			return;
+		}
+		running = false;
+
+		if (acceptThread.joinable()) {
+			acceptThread.join();
+		}
+		httplib::detail::close_socket(listenSock);
+		listenSock = INVALID_SOCKET;
+
+		std::list<std::shared_ptr<Session>> remaining;
+		{
+			std::lock_guard<std::mutex> _(m);
+			remaining.swap(sessions);
+		}
+
+		// unblocks reads and writes, handlers see a closed connection
+		for (auto &session : remaining) {
+			httplib::detail::shutdown_socket(session->sock);
+		}
+		for (auto &session : remaining) {
+			session->thread.join();
+			httplib::detail::close_socket(session->sock);
+		}
+	}
+
+	bool IsRunning() const
+	{
+		return running;
+	}
+
+private:
+	struct Session
+	{
+		socket_t sock;
+		std::thread thread;
+		std::atomic<bool> done = false;
+	};
+
+	void AcceptLoop()
+	{
+		while (running) {
+			if (httplib::detail::select_read(listenSock, 0, 200000) <= 0) {
+				continue;
+			}
+
+			socket_t sock = accept(listenSock, nullptr, nullptr);
+			if (sock == INVALID_SOCKET) {
+				continue;
+			}
+
+			std::lock_guard<std::mutex> _(m);
+
+			// reap finished connections
+			for (auto it = sessions.begin(); it != sessions.end();) {
+				if ((*it)->done) {
+					(*it)->thread.join();
+					httplib::detail::close_socket((*it)->sock);
+					it = sessions.erase(it);
+				} else {
+					++it;
+				}
+			}
+
+			if ((int)sessions.size() >= maxConnections) {
+				static const std::string busy = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+				send(sock, busy.data(), (int)busy.size(), 0);
+				httplib::detail::close_socket(sock);
+				continue;
+			}
+
+			auto session = std::make_shared<Session>();
+			session->sock = sock;
+			session->thread = std::thread([this, session] {
+				WebSocketConnection ws(session->sock);
+
+				// nothing above this thread catches, an escaping exception would end the game
+				try {
+					std::string path;
+					if (ws.Handshake(path)) {
+						handler(ws, path);
+					}
+					ws.Close();
+				} catch (...) {
+					ws.Close(1011);
+				}
+
+				session->done = true;
+			});
+			sessions.push_back(session);
+		}
+	}
+
+	Handler handler;
+	int maxConnections = 8;
+
+	std::atomic<bool> running = false;
+	socket_t listenSock = INVALID_SOCKET;
+	std::thread acceptThread;
+
+	std::mutex m;
+	std::list<std::shared_ptr<Session>> sessions;
+};
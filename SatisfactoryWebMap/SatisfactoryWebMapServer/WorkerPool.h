@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads for splitting one job into independent pieces.
+// The calling thread works on the job too, so a pool of size 1 runs everything inline.
+class WorkerPool
+{
+public:
+	explicit WorkerPool(int threads = 1)
+	{
+		for (int i = 1; i < threads; ++i) {
+			workers.emplace_back([this] { Run(); });
+		}
+	}
+
+	WorkerPool(const WorkerPool &) = delete;
+	WorkerPool &operator=(const WorkerPool &) = delete;
+
+	~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> _(m);
+			stopping = true;
+		}
+		cv.notify_all();
+
+		for (auto &worker : workers) {
+			worker.join();
+		}
+	}
+
+	int Size() const
+	{
+		return (int)workers.size() + 1;
+	}
+
+	// Calls fn(i) for every i in [0, n) and returns once all calls finished.
+	// fn runs concurrently and must not throw.
+	void ParallelFor(int n, const std::function<void(int)> &fn)
+	{
+		if (n <= 0) {
+			return;
+		}
+
+		// one job at a time
+		std::lock_guard<std::mutex> job(jobLock);
+
+		{
+			std::lock_guard<std::mutex> _(m);
+			task = &fn;
+			count = n;
+			next = 0;
+			pending = n;
+			++generation;
+		}
+		cv.notify_all();
+
+		Work();
+
+		// also wait for workers that picked up the job but found nothing left,
+		// they still hold fn and must not carry it into the next job
+		std::unique_lock<std::mutex> lock(m);
+		doneCv.wait(lock, [this] { return pending == 0 && active == 0; });
+		task = nullptr;
+	}
+
+private:
+	void Run()
+	{
+		uint64_t seen = 0;
+
+		std::unique_lock<std::mutex> lock(m);
+		while (true) {
+			cv.wait(lock, [&] { return stopping || generation != seen; });
+			if (stopping) {
+				return;
+			}
+			seen = generation;
+
+			lock.unlock();
+			Work();
+			lock.lock();
+		}
+	}
+
+	void Work()
+	{
+		const std::function<void(int)> *fn;
+		int n;
+		{
+			std::lock_guard<std::mutex> _(m);
+			fn = task;
+			n = count;
+			if (fn == nullptr) {
+				return;
+			}
+			++active;
+		}
+
+		int finished = 0;
+		for (int i; (i = next.fetch_add(1)) < n;) {
+			(*fn)(i);
+			++finished;
+		}
+
+		std::lock_guard<std::mutex> _(m);
+		pending -= finished;
+		if (--active == 0 && pending == 0) {
+			doneCv.notify_all();
+		}
+	}
+
+	std::vector<std::thread> workers;
+
+	std::mutex jobLock;
+
+	std::mutex m;
+	std::condition_variable cv;
+	std::condition_variable doneCv;
+
+	const std::function<void(int)> *task = nullptr;
+	int count = 0;
+	std::atomic<int> next = 0;
+	int pending = 0;
+	int active = 0;
+	uint64_t generation = 0;
+	bool stopping = false;
+};
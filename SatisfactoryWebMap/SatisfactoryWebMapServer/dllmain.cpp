@@ -2,19 +2,36 @@
 #include <Windows.h>
 #include <httplib.h>
 
+#define STBI_NO_PIC
+#define STBI_NO_HDR
+#define STBI_NO_PNM
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#undef STB_IMAGE_IMPLEMENTATION
+
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include <stb_image_resize.h>
+#undef STB_IMAGE_RESIZE_IMPLEMENTATION
+
 #include <filesystem>
 #include <iostream>
 
 #include "Config.h"
+#include "StaticFiles.h"
+#include "BaseMapTiles.h"
 
 #define ModuleName "SatisfactoryWebMapServer"
 
 bool setup();
+void shutdown();
 
 using namespace httplib;
 
 Server s;
 Config config;
+StaticFiles staticFiles;
+BaseMapTiles baseTiles;
 
 std::filesystem::path dllDir;
 
@@ -51,6 +68,16 @@ void MainThread(HMODULE hModule)
 		return;
 	}
 
+	// streams hold a worker each, keep enough for plain requests
+	s.new_task_queue = [] {
+		return new ThreadPool((std::max)(config.Threads, config.MaxStreams + 4));
+	};
+
+	s.Get("/api/stop", [&](const Request &req, Response &res) {
+		s.stop();
+	});
+
+	// registered last, handlers are matched in order
 	if (!config.APIOnly) {
 		auto root = config.Root;
 		if (root.empty()) {
@@ -59,7 +86,7 @@ void MainThread(HMODULE hModule)
 
 		OutputDebugStringA(("Using " + root + " as webroot").c_str());
 
-		auto ret = s.set_mount_point("/", root.c_str());
+		auto ret = staticFiles.Load(root, config.CompressionLevel);
 		if (!ret) {
 			std::string path;
 			path.resize(MAX_PATH);
@@ -68,16 +95,49 @@ void MainThread(HMODULE hModule)
 
 			MessageBoxA(NULL, (path + " dose not exists").c_str(), ModuleName, MB_ICONERROR);
 		}
-	}
 
-	s.Get("/api/stop", [&](const Request &req, Response &res) {
-		s.stop();
-	});
+		// the page falls back to the whole image until the pyramid is cut
+		auto tileCache = config.TileCacheDir.empty() ? (dllDir / "tile_cache").string() : config.TileCacheDir;
+		if (!baseTiles.Start(root + "/img/map.png", tileCache, config.ScanThreads, config.CompressionLevel)) {
+			OutputDebugStringA("No img/map.png in the webroot, base map tiles are off.");
+		}
+
+		s.Get("/tiles/base/info\\.json", [&](const Request &req, Response &res) {
+			res.set_header("Cache-Control", "no-cache");
+			res.set_content(baseTiles.Info(), "application/json");
+		});
+
+		s.Get(R"(/tiles/base/(-?\d+)/(-?\d+)/(-?\d+)\.png)", [&](const Request &req, Response &res) {
+			auto tile = baseTiles.Get(std::atoi(req.matches[1].str().c_str()), std::atoi(req.matches[2].str().c_str()),
+				std::atoi(req.matches[3].str().c_str()));
+			if (!tile) {
+				res.status = 404;
+				return;
+			}
+
+			// the url does not change with the source, so revalidate by content
+			res.set_header("Cache-Control", "no-cache");
+			if (NotModified(req, res, "\"" + HashToHex(Fnv1a64(*tile)) + "\"")) {
+				return;
+			}
+			res.set_content(*tile, "image/png");
+		});
+
+		s.Get(".*", [&](const Request &req, Response &res) {
+			if (!staticFiles.Serve(req, res)) {
+				res.status = 404;
+			}
+		});
+	}
 
 	SetEvent(readyEvent);
 
 	s.listen(config.IP.c_str(), config.Port);
 
+	shutdown();
+	staticFiles.Stop();
+	baseTiles.Stop();
+
 	ResetEvent(readyEvent);
 	CloseHandle(readyEvent);
 
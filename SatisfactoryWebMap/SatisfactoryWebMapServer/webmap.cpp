@@ -3,42 +3,299 @@
 #include <httplib.h>
 #include <psapi.h>
 
+#include <memory>
 #include <vector>
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <cmath>
+#include <cfloat>
+#include <filesystem>
 
 #include "FactoryGameSDK.h"
 #include "Config.h"
+#include "Snapshot.h"
+#include "HttpHelpers.h"
+#include "WebSocket.h"
+#include "ActorsBinary.h"
+#include "GeoJsonWriter.h"
+#include "MemorySource.h"
+#include "ActorSampler.h"
+#include "ActorsApi.h"
+#include "NameTable.h"
+#include "ObjectScanner.h"
+#include "ObjectIndex.h"
+#include "VectorTile.h"
+#include "TileCache.h"
+#include "TrailStore.h"
+#include "SnapshotLog.h"
+#include "RollupStore.h"
 
 extern httplib::Server s;
 extern Config config;
+extern std::filesystem::path dllDir;
 
 const uint8_t *BaseAddr = nullptr;
 const TNameEntryArray *Names_0 = nullptr;
 const FUObjectArray *GUObjectArray = nullptr;
 const FGMapManager *MapManager = nullptr;
 
+SnapshotEngine snapshots;
+std::atomic<int> activeStreams = 0;
+WebSocketServer sockets;
+ProcessMemory gameMemory;
+NameTable nameTable(gameMemory);
+std::unique_ptr<WorkerPool> workers;
+std::unique_ptr<ObjectScanner> scanner;
+std::unique_ptr<ObjectIndex> objectIndex;
+TileCache actorTiles(32 << 20);
+std::unique_ptr<ActorScheduler> scheduler;
+std::unique_ptr<TrailStore> trails;
+std::unique_ptr<RollupStore> rollups;
+SnapshotLog snapshotLog;
+
 bool FindMapManager()
 {
 	if (BaseAddr == nullptr) {
 		return false;
 	}
 
-	const auto &ObjObjects = GUObjectArray->ObjObjects;
-	for (int Index = 0; Index < ObjObjects.NumElements; ++Index) {
-		const FUObjectItem *Object = &ObjObjects[Index];
-		if (Object->Object == nullptr) {
+	auto object = scanner->FindFirstByName(config.MapManagerName);
+	if (object == nullptr) {
+		return false;
+	}
+
+	MapManager = (const FGMapManager *)object;
+	return true;
+}
+
+// Walks the representation manager once, only called from the snapshot thread
+bool SampleActors(std::vector<ActorState> &actors, std::string &error)
+{
+	if (!RepresentationManager(gameMemory, MapManager)) {
+		if (!FindMapManager() || !RepresentationManager(gameMemory, MapManager)) {
+			error = "invalid obj";
+			return false;
+		}
+	}
+
+	if (scheduler) {
+		return scheduler->Sample(gameMemory, MapManager, actors, error);
+	}
+	return ReadActors(gameMemory, MapManager, actors, error);
+}
+
+nlohmann::json ActorToFeature(const ActorState &actor)
+{
+	using json = nlohmann::json;
+
+	json j;
+
+	j["type"] = "Feature";
+	j["properties"] =
+	{
+		{  "type", actor.Type                                         },
+		{ "index", actor.Index                                        },
+		{ "color", std::vector<int32_t>(actor.Color, actor.Color + 4) },
+	};
+
+	j["geometry"]["type"] = "Point";
+	j["geometry"]["coordinates"] = std::vector<float>(actor.Location, actor.Location + 3);
+
+	j["properties"]["ang"] = std::vector<float>(actor.Rotation, actor.Rotation + 3);
+	if (actor.HasVelocity) {
+		j["properties"]["vel"] = std::vector<float>(actor.Velocity, actor.Velocity + 3);
+	}
+
+	return j;
+}
+
+// Body of /api/actors/delta, a full snapshot when base is nullptr
+std::string SerializeDelta(const Snapshot *base, const Snapshot &snapshot)
+{
+	thread_local std::string buffer;
+	buffer.clear();
+
+	GeoJsonWriter(buffer).Delta(base, snapshot);
+	return buffer;
+}
+
+// Delta body from since to snapshot, computed once per pair and shared by /api/actors/delta and the stream
+std::shared_ptr<const std::string> DeltaBody(const SnapshotPtr &snapshot, uint64_t since)
+{
+	// unknown or too old sequence, fall back to a full snapshot
+	auto base = snapshots.Find(since);
+	if (base && (!base->Valid || base->Seq > snapshot->Seq)) {
+		base = nullptr;
+	}
+
+	std::lock_guard<std::mutex> _(snapshot->DeltaLock);
+
+	auto &body = snapshot->DeltaBodies[base ? base->Seq : 0];
+	if (!body) {
+		body = std::make_shared<const std::string>(SerializeDelta(base.get(), *snapshot));
+	}
+
+	return body;
+}
+
+// One WebSocket client. Sends filtered deltas against what this client already has,
+// so moving the viewport only sends actors entering or leaving it.
+void ServeActorSocket(WebSocketConnection &ws, const std::string &path)
+{
+	using json = nlohmann::json;
+	using clock = std::chrono::steady_clock;
+
+	if (path.substr(0, path.find('?')) != "/api/actors/ws") {
+		ws.Close(1008);
+		return;
+	}
+
+	// WebSocket clients count against max_streams like /api/actors/stream ones
+	if (++activeStreams > config.MaxStreams) {
+		--activeStreams;
+		ws.Close(1013);
+		return;
+	}
+	struct StreamSlot
+	{
+		~StreamSlot() { --activeStreams; }
+	} slot;
+
+	ActorSubscription sub;
+	sub.Rate = (std::max)(config.SnapshotInterval, 50);
+
+	// index -> (hash sent, generation it was last seen in)
+	std::unordered_map<int32_t, std::pair<uint64_t, uint64_t>> known;
+	uint64_t generation = 0;
+
+	uint64_t lastSeq = 0;
+	bool dirty = true, full = true;
+	auto nextSend = clock::now();
+
+	auto send = [&](const json &j) {
+		if (sub.Binary) {
+			auto bytes = json::to_msgpack(j);
+			return ws.SendBinary(bytes.data(), bytes.size());
+		}
+		// parse errors quote the frame, which may not be UTF-8
+		return ws.SendText(j.dump(-1, ' ', false, json::error_handler_t::replace));
+	};
+
+	while (ws.IsOpen() && snapshots.IsRunning()) {
+		auto now = clock::now();
+		auto waitMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(nextSend - now).count();
+
+		std::string message;
+		bool binary = false, got = false;
+		if (!ws.Poll((std::min)((std::max)(waitMs, 0), 250), message, binary, got)) {
+			break;
+		}
+
+		if (got) {
+			bool resync = false;
+			std::string error;
+
+			try {
+				auto msg = binary ? json::from_msgpack(message) : json::parse(message);
+				error = sub.Update(msg, resync);
+			} catch (const std::exception &e) {
+				error = e.what();
+			}
+
+			if (!error.empty()) {
+				send({ { "status", "err" }, { "msg", error } });
+				continue;
+			}
+
+			if (resync) {
+				known.clear();
+				full = true;
+			}
+
+			// answer filter changes right away instead of waiting for the next tick
+			dirty = true;
+			nextSend = clock::now();
 			continue;
 		}
 
-		if (Object->Object->NamePrivate == config.MapManagerName) {
-			MapManager = (FGMapManager *)(Object->Object);
-			return true;
+		if (clock::now() < nextSend) {
+			continue;
 		}
+
+		auto snapshot = snapshots.Latest();
+		if (!snapshot || (snapshot->Seq == lastSeq && !dirty)) {
+			nextSend = clock::now() + std::chrono::milliseconds(50);
+			continue;
+		}
+
+		if (!snapshot->Valid) {
+			if (snapshot->Seq != lastSeq) {
+				send({ { "status", "err" }, { "msg", snapshot->Error }, { "seq", snapshot->Seq } });
+			}
+		} else {
+			std::vector<json> added, changed;
+			std::vector<int32_t> removed;
+
+			thread_local std::vector<const ActorState *> selected;
+			sub.Select(*snapshot, selected);
+
+			++generation;
+			for (const auto *match : selected) {
+				const auto &actor = *match;
+				auto it = known.find(actor.Index);
+				if (it == known.end()) {
+					known.emplace(actor.Index, std::make_pair(actor.Hash, generation));
+					added.push_back(ActorToFeature(actor));
+				} else {
+					if (it->second.first != actor.Hash) {
+						it->second.first = actor.Hash;
+						changed.push_back(ActorToFeature(actor));
+					}
+					it->second.second = generation;
+				}
+			}
+
+			// gone from the snapshot or filtered out now
+			for (auto it = known.begin(); it != known.end();) {
+				if (it->second.second != generation) {
+					removed.push_back(it->first);
+					it = known.erase(it);
+				} else {
+					++it;
+				}
+			}
+
+			if (full || !added.empty() || !changed.empty() || !removed.empty()) {
+				send({
+					{ "status", "ok" },
+					{ "seq", snapshot->Seq },
+					{ "full", full },
+					{ "added", added },
+					{ "changed", changed },
+					{ "removed", removed },
+				});
+				full = false;
+			}
+		}
+
+		lastSeq = snapshot->Seq;
+		dirty = false;
+		nextSend = clock::now() + std::chrono::milliseconds(sub.Rate);
 	}
+}
 
-	return false;
+void shutdown()
+{
+	sockets.Stop();
+	if (trails) {
+		trails->Stop();
+	}
+	if (rollups) {
+		rollups->Stop();
+	}
+	snapshotLog.Stop();
+	snapshots.Stop();
 }
 
 bool setup()
@@ -58,43 +315,57 @@ bool setup()
 
 	Names_0 = *(TNameEntryArray **)(BaseAddr + config.TNameEntryArrayOffset);
 	GUObjectArray = (FUObjectArray *)(BaseAddr + config.GUObjectArrayOffset);
+	nameTable.Refresh();
+	workers = std::make_unique<WorkerPool>((std::max)(config.ScanThreads, 1));
+	scanner = std::make_unique<ObjectScanner>(gameMemory, nameTable, *workers);
+	objectIndex = std::make_unique<ObjectIndex>(gameMemory, nameTable, *workers);
 
 	FindMapManager();
-	if (!MapManager || !MapManager->mActorRepresentationManager) {
+	if (!RepresentationManager(gameMemory, MapManager)) {
 		OutputDebugStringA("Unable to find MapManager during setup.");
 	}
 
 	s.Get("/api/dump", [&](const Request &req, Response &res) {
 		std::ofstream ofs("dump.txt", std::ofstream::out);
 
+		auto names = gameMemory.Get(Names_0);
+		auto objects = gameMemory.Get(&GUObjectArray->ObjObjects);
+
 		ofs << "BaseAddr = " << (void *)BaseAddr << std::endl
 			<< "TNameEntryArray *Names = " << (void *)Names_0 << std::endl
-			<< "NumElements = " << Names_0->NumElements << " "
-			<< "NumChunks = " << Names_0->NumChunks << std::endl;
+			<< "NumElements = " << names.NumElements << " "
+			<< "NumChunks = " << names.NumChunks << std::endl;
 
 		ofs << "FUObjectArray *GUObjectArray = " << (void *)GUObjectArray << std::endl
-			<< "NumElements = " << GUObjectArray->ObjObjects.NumElements << " "
-			<< "NumChunks = " << GUObjectArray->ObjObjects.NumChunks << std::endl;
+			<< "NumElements = " << objects.NumElements << " "
+			<< "NumChunks = " << objects.NumChunks << std::endl;
 
 		ofs << std::endl;
 
 		int count = 0;
+		std::string name;
 
-		const auto &ObjObjects = GUObjectArray->ObjObjects;
-		for (int Index = 0; Index < ObjObjects.NumElements; ++Index) {
-			const FUObjectItem *Object = &ObjObjects[Index];
-			if (Object->Object == nullptr) {
+		for (int Index = 0; Index < objects.NumElements; ++Index) {
+			auto chunk = gameMemory.Get(objects.Objects + Index / FChunkedFixedUObjectArray::NumElementsPerChunk);
+
+			FUObjectItem Object{};
+			if (chunk == nullptr || !gameMemory.Read(chunk + Index % FChunkedFixedUObjectArray::NumElementsPerChunk, Object) || Object.Object == nullptr) {
 				continue;
 			}
 
+			auto NamePrivate = gameMemory.Get(&Object.Object->NamePrivate);
+
 			++count;
+			name.clear();
+			nameTable.Append(name, NamePrivate);
+
 			ofs << "[" << Index << "]" 
-				<< " SerialNumber: " << Object->SerialNumber 
-				<< " Flags: " << Object->Flags << " Object: " << Object->Object 
+				<< " SerialNumber: " << Object.SerialNumber 
+				<< " Flags: " << Object.Flags << " Object: " << Object.Object 
 				<< std::endl << "\t"
-				<< "NamePrivate: Number=" << Object->Object->NamePrivate.Number
-				<< " ComparisonIndex=" << Object->Object->NamePrivate.ComparisonIndex
-				<< " String=\"" << Object->Object->NamePrivate << "\""
+				<< "NamePrivate: Number=" << NamePrivate.Number
+				<< " ComparisonIndex=" << NamePrivate.ComparisonIndex
+				<< " String=\"" << name << "\""
 				<< std::endl;
 		}
 
@@ -108,59 +379,489 @@ bool setup()
 		res.set_content(json({ {"status", "ok"}, { "path", path } }), "application/json");
 	});
 
+	// The pages behind one name lookup, one index refresh and one actor sample, for the benchmarks.
+	// The binary sibling of /api/dump.
+	s.Get("/api/capture", [&](const Request &req, Response &res) {
+		// plain file names only, next to dump.txt
+		auto file = req.has_param("file") ? req.get_param_value("file") : "capture.bin";
+		if (file.empty() || file.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-.") != std::string::npos || file[0] == '.') {
+			res.set_content(R"({"status": "err", "msg": "invalid file name"})", "application/json");
+			return;
+		}
+
+		RecordingMemory recorder(gameMemory);
+		WorkerPool single;
+
+		NameTable names(recorder);
+		names.Refresh();
+
+		ObjectScanner(recorder, names, single).FindFirstByName(config.MapManagerName);
+		ObjectIndex(recorder, names, single).Refresh();
+
+		std::vector<ActorState> actors;
+		std::string error;
+		ReadActors(recorder, MapManager, actors, error);
+
+		if (!recorder.Save(file, {
+			{ "names", (uint64_t)(uintptr_t)Names_0 },
+			{ "objects", (uint64_t)(uintptr_t)GUObjectArray },
+			{ "mapmanager", (uint64_t)(uintptr_t)MapManager },
+		})) {
+			res.set_content(R"({"status": "err", "msg": "unable to write the capture"})", "application/json");
+			return;
+		}
+
+		std::string path;
+		path.resize(MAX_PATH);
+		GetFullPathNameA(file.c_str(), path.size(), &path[0], nullptr);
+
+		res.set_content(json({ { "status", "ok" }, { "path", path }, { "actors", actors.size() } }).dump(), "application/json");
+	});
+
+	s.Get("/api/stats/classes", [&](const Request &req, Response &res) {
+		objectIndex->Refresh(std::chrono::milliseconds(config.SnapshotInterval));
+
+		json classes = json::array();
+		for (const auto &entry : objectIndex->ClassHistogram()) {
+			classes.push_back({ { "name", entry.Name }, { "count", entry.Count } });
+		}
+
+		res.set_content(json({ { "status", "ok" }, { "objects", objectIndex->Size() }, { "classes", classes } }).dump(), "application/json");
+	});
+
+	s.Get("/api/objects", [&](const Request &req, Response &res) {
+		std::vector<int32_t> found;
+		if (req.has_param("class")) {
+			objectIndex->Refresh(std::chrono::milliseconds(config.SnapshotInterval));
+			found = objectIndex->FindByClass(req.get_param_value("class"));
+		} else if (req.has_param("name")) {
+			objectIndex->Refresh(std::chrono::milliseconds(config.SnapshotInterval));
+			for (const auto &key : scanner->ResolveName(req.get_param_value("name"))) {
+				auto slots = objectIndex->FindByName({ key.ComparisonIndex, key.Number });
+				found.insert(found.end(), slots.begin(), slots.end());
+			}
+			std::sort(found.begin(), found.end());
+		} else {
+			res.set_content(R"({"status": "err", "msg": "class or name required"})", "application/json");
+			return;
+		}
+
+		json objects = json::array();
+		for (auto index : found) {
+			objects.push_back({ { "index", index }, { "name", nameTable.ToString(objectIndex->NameOf(index)) } });
+		}
+
+		res.set_content(json({ { "status", "ok" }, { "objects", objects } }).dump(), "application/json");
+	});
+
 	s.Get("/api/actors", [&](const Request &req, Response &res) {
-		if (!MapManager || !MapManager->mActorRepresentationManager) {
-			if (!FindMapManager() || !MapManager || !MapManager->mActorRepresentationManager) {
-				res.set_content(R"({"status": "err", "msg": "invalid obj"})", "application/json");
+		ActorSubscription filter;
+		auto error = filter.ParseQuery(req);
+		if (!error.empty()) {
+			res.set_content(json({ { "status", "err" }, { "msg", error } }).dump(), "application/json");
+			return;
+		}
+
+		// ?at=<unix ms>, replayed from the snapshot log
+		if (req.has_param("at")) {
+			auto text = req.get_param_value("at");
+			char *end = nullptr;
+			auto at = std::strtoll(text.c_str(), &end, 10);
+			if (text.empty() || *end != '\0') {
+				res.set_content(R"({"status": "err", "msg": "invalid at"})", "application/json");
 				return;
 			}
+
+			auto past = snapshotLog.At(at);
+			if (!past) {
+				res.set_content(R"({"status": "err", "msg": "no snapshot at that time"})", "application/json");
+				return;
+			}
+
+			res.set_header("X-Snapshot-Time", std::to_string(past->Time).c_str());
+			SendFilteredActors(req, res, past, filter, config.CompressionLevel);
+			return;
 		}
 
-		auto respMgr = MapManager->mActorRepresentationManager;
-		auto size = respMgr->mReplicatedRepresentations.ArrayNum;
+		auto snapshot = snapshots.Latest();
+		if (!snapshot) {
+			res.set_content(R"({"status": "err", "msg": "invalid obj"})", "application/json");
+			return;
+		}
 
-		std::vector<json> features;
-		features.reserve(size);
+		SendActors(req, res, snapshot, filter, config.CompressionLevel);
+	});
 
-		for (int i = 0; i < size; ++i) {
-			auto actorResp = respMgr->mReplicatedRepresentations.Data[i];
-			if (actorResp == nullptr) {
-				continue;
+	s.Get("/api/clusters", [&](const Request &req, Response &res) {
+		auto snapshot = snapshots.Latest();
+		if (!snapshot) {
+			res.set_content(R"({"status": "err", "msg": "invalid obj"})", "application/json");
+			return;
+		}
+
+		auto text = req.get_param_value("z");
+		char *end = nullptr;
+		auto zoom = std::strtod(text.c_str(), &end);
+		if (text.empty() || *end != '\0' || !std::isfinite(zoom)) {
+			res.set_content(R"({"status": "err", "msg": "z required"})", "application/json");
+			return;
+		}
+
+		ActorSubscription filter;
+		auto error = filter.ParseQuery(req);
+		if (error.empty() && !filter.Types.empty()) {
+			error = "types not supported";
+		}
+		if (!error.empty()) {
+			res.set_content(json({ { "status", "err" }, { "msg", error } }).dump(), "application/json");
+			return;
+		}
+
+		thread_local std::string body;
+		body.clear();
+
+		// zoomed in past the last level, the actors themselves
+		if (zoom >= ClusterIndex::MaxZoom + 1) {
+			thread_local std::vector<const ActorState *> selected;
+			filter.Select(*snapshot, selected);
+			GeoJsonWriter(body).FeatureCollection(*snapshot, selected);
+		} else {
+			const float everywhere[4] = { -FLT_MAX, -FLT_MAX, FLT_MAX, FLT_MAX };
+			int z = (std::max)((int)std::floor(zoom), ClusterIndex::MinZoom);
+
+			thread_local std::vector<const ClusterIndex::Cluster *> clusters;
+			snapshot->Clusters().Query(z, filter.HasBounds ? filter.Bounds : everywhere, clusters);
+			GeoJsonWriter(body).Clusters(*snapshot, z, clusters);
+		}
+
+		SendJsonBody(req, res, body, config.CompressionLevel);
+	});
+
+	s.Get(R"(/tiles/actors/(-?\d+)/(-?\d+)/(-?\d+)\.mvt)", [&](const Request &req, Response &res) {
+		int z = std::atoi(req.matches[1].str().c_str());
+		int x = std::atoi(req.matches[2].str().c_str());
+		int y = std::atoi(req.matches[3].str().c_str());
+
+		auto snapshot = snapshots.Latest();
+		if (!snapshot || z < mvt::MinZoom || z > mvt::MaxZoom) {
+			res.status = 404;
+			return;
+		}
+
+		float box[4];
+		mvt::TileBounds(z, x, y, box);
+
+		thread_local std::vector<const ActorState *> selected;
+		snapshot->Grid.Query(snapshot->Actors, box, SpatialGrid::AllTypes, selected);
+
+		// what the tile shows: where it is, then index and state of every actor in it.
+		// A tile nothing moved in keeps its key between snapshots and is never encoded again.
+		const int32_t id[3] = { z, x, y };
+		auto key = Fnv1a64(id, sizeof(id));
+		for (const auto *actor : selected) {
+			key = Fnv1a64(&actor->Index, sizeof(actor->Index), key);
+			key = Fnv1a64(&actor->Hash, sizeof(actor->Hash), key);
+		}
+
+		auto body = actorTiles.Get(key, [&] {
+			return mvt::EncodeActorTile(z, x, y, selected);
+		});
+
+		std::string encoding;
+		if (config.CompressionLevel > 0 && body->size() >= 256) {
+			encoding = AcceptedEncoding(req);
+		}
+
+		auto etag = "\"" + HashToHex(key);
+		if (!encoding.empty()) {
+			etag += "-" + encoding;
+		}
+		etag += "\"";
+
+		res.set_header("Cache-Control", "no-cache");
+		res.set_header("Vary", "Accept-Encoding");
+		if (NotModified(req, res, etag)) {
+			return;
+		}
+
+		if (!encoding.empty()) {
+			body = actorTiles.Get(Fnv1a64(encoding, key), [&] {
+				return EncodeContent(encoding, *body, config.CompressionLevel);
+			});
+			res.set_header("Content-Encoding", encoding);
+		}
+
+		res.set_content(*body, "application/vnd.mapbox-vector-tile");
+	});
+
+	// where actors have been: ?index= for one trail, ?bbox= for every trail through the box,
+	// since= a unix time in ms
+	s.Get("/api/history", [&](const Request &req, Response &res) {
+		auto error = [&](const char *msg) {
+			res.set_content(json({ { "status", "err" }, { "msg", msg } }).dump(), "application/json");
+		};
+
+		int64_t since = 0;
+		if (req.has_param("since")) {
+			auto text = req.get_param_value("since");
+			char *end = nullptr;
+			since = std::strtoll(text.c_str(), &end, 10);
+			if (text.empty() || *end != '\0') {
+				return error("invalid since");
 			}
+		}
 
-			json j;
+		thread_local std::vector<TrailStore::Trail> found;
+		found.clear();
 
-			j["type"] = "Feature";
-			j["properties"] =
-			{
-				{  "type", actorResp->mRepresentationType          },
-				{ "index", actorResp->InternalIndex                },
-				{ "color", actorResp->mRepresentationColor.ToVec() },
-			};
+		if (req.has_param("index")) {
+			auto text = req.get_param_value("index");
+			char *end = nullptr;
+			auto index = std::strtol(text.c_str(), &end, 10);
+			if (text.empty() || *end != '\0') {
+				return error("invalid index");
+			}
 
-			j["geometry"]["type"] = "Point";
+			found.emplace_back();
+			if (!trails->Get((int32_t)index, since, found.back())) {
+				found.clear();
+			}
+		} else if (req.has_param("bbox")) {
+			ActorSubscription filter;
+			auto message = filter.ParseQuery(req);
+			if (!message.empty()) {
+				return error(message.c_str());
+			}
+			trails->Find(filter.Bounds, since, found);
+		} else {
+			return error("index or bbox required");
+		}
 
-			AActor *realActor = actorResp->mRealActor;
-			if (realActor == nullptr) {
-				j["geometry"]["coordinates"] = actorResp->mActorLocation.ToVec();
-				j["properties"]["ang"] = actorResp->mActorRotation.ToVec();
-			} else {
-				j["geometry"]["coordinates"] = realActor->RootComponent->ComponentToWorld.Translation.ToVector3().ToVec();
+		thread_local std::string body;
+		body.clear();
+		GeoJsonWriter(body).Trails(found);
 
-				j["properties"]["ang"] = realActor->RootComponent->ComponentToWorld.Rotation.ToVector3().ToVec();
-				j["properties"]["vel"] = realActor->RootComponent->ComponentVelocity.ToVec();
+		SendJsonBody(req, res, body, config.CompressionLevel);
+	});
+
+	// where actors have been over long spans: ?index= or ?bbox= as for /api/history, from= and to=
+	// unix times in ms (the last hour by default), points= the most buckets per actor
+	s.Get("/api/rollups", [&](const Request &req, Response &res) {
+		auto error = [&](const char *msg) {
+			res.set_content(json({ { "status", "err" }, { "msg", msg } }).dump(), "application/json");
+		};
+
+		auto integer = [&](const char *name, int64_t &value) {
+			if (!req.has_param(name)) {
+				return true;
 			}
+			auto text = req.get_param_value(name);
+			char *end = nullptr;
+			value = std::strtoll(text.c_str(), &end, 10);
+			return !text.empty() && *end == '\0';
+		};
+
+		auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+
+		int64_t to = now, from = 0, points = 500;
+		if (!integer("to", to)) {
+			return error("invalid to");
+		}
+		from = to - 3600 * 1000;
+		if (!integer("from", from) || from > to) {
+			return error("invalid from");
+		}
+		if (!integer("points", points) || points <= 0) {
+			return error("invalid points");
+		}
 
-			features.push_back(j);
+		auto tier = RollupStore::PickTier(from, to, (size_t)points, now);
+
+		thread_local std::vector<RollupStore::Series> found;
+		found.clear();
+
+		if (req.has_param("index")) {
+			int64_t index = 0;
+			if (!integer("index", index)) {
+				return error("invalid index");
+			}
+
+			found.emplace_back();
+			if (!rollups->Get((int32_t)index, tier, from, to, found.back())) {
+				found.clear();
+			}
+		} else if (req.has_param("bbox")) {
+			ActorSubscription filter;
+			auto message = filter.ParseQuery(req);
+			if (!message.empty()) {
+				return error(message.c_str());
+			}
+			rollups->Find(filter.Bounds, tier, from, to, found);
+		} else {
+			return error("index or bbox required");
 		}
 
-		// return GeoJSON object
-		res.set_content(json({ 
-			{ "status", "ok" }, 
-			{ "type", "FeatureCollection" },
-			{ "features", features },
-		}).dump(), "application/json");
+		thread_local std::string body;
+		body.clear();
+		GeoJsonWriter(body).Rollups(found);
+
+		SendJsonBody(req, res, body, config.CompressionLevel);
 	});
 
+	s.Get("/api/actors\\.bin", [&](const Request &req, Response &res) {
+		auto snapshot = snapshots.Latest();
+		if (!snapshot) {
+			res.set_content(R"({"status": "err", "msg": "invalid obj"})", "application/json");
+			return;
+		}
+
+		SendSnapshot(req, res, snapshot, "bin", "application/octet-stream", config.CompressionLevel);
+	});
+
+	s.Get("/api/actors/delta", [&](const Request &req, Response &res) {
+		auto snapshot = snapshots.Latest();
+		if (!snapshot || !snapshot->Valid) {
+			res.set_content(R"({"status": "err", "msg": "invalid obj"})", "application/json");
+			return;
+		}
+
+		uint64_t since = 0;
+		if (req.has_param("since")) {
+			since = std::strtoull(req.get_param_value("since").c_str(), nullptr, 10);
+		}
+
+		auto body = DeltaBody(snapshot, since);
+		res.set_content(*body, "application/json");
+	});
+
+	s.Get("/api/actors/stream", [&](const Request &req, Response &res) {
+		if (++activeStreams > config.MaxStreams) {
+			--activeStreams;
+			res.status = 503;
+			res.set_content(R"({"status": "err", "msg": "too many streams"})", "application/json");
+			return;
+		}
+
+		// seq of the last frame sent to this client, EventSource sends it back when reconnecting
+		auto lastSeq = std::make_shared<uint64_t>(0);
+		if (req.has_header("Last-Event-ID")) {
+			*lastSeq = std::strtoull(req.get_header_value("Last-Event-ID").c_str(), nullptr, 10);
+		}
+
+		// id from before a server restart
+		auto latest = snapshots.Latest();
+		if (!latest || *lastSeq > latest->Seq) {
+			*lastSeq = 0;
+		}
+
+		// binary frames are always full snapshots
+		bool binary = req.get_param_value("format") == "bin";
+		bool fullOnly = binary || req.has_param("full");
+
+		// a filtered stream sends the filtered snapshot whenever it changed
+		auto filter = std::make_shared<ActorSubscription>();
+		auto error = filter->ParseQuery(req);
+		if (error.empty() && binary && filter->IsFiltered()) {
+			error = "bbox and types need json";
+		}
+		if (!error.empty()) {
+			--activeStreams;
+			res.set_content(json({ { "status", "err" }, { "msg", error } }).dump(), "application/json");
+			return;
+		}
+		auto lastHash = std::make_shared<uint64_t>(0);
+
+		auto lastWrite = std::make_shared<std::chrono::steady_clock::time_point>(std::chrono::steady_clock::now());
+
+		res.set_header("Content-Type", "text/event-stream");
+		res.set_header("Cache-Control", "no-cache");
+
+		res.set_chunked_content_provider([lastSeq, lastWrite, fullOnly, binary, filter, lastHash](size_t offset, DataSink &sink) {
+			auto snapshot = snapshots.WaitNewer(*lastSeq, std::chrono::milliseconds(500));
+			if (!snapshots.IsRunning()) {
+				sink.done();
+				return true;
+			}
+
+			auto now = std::chrono::steady_clock::now();
+
+			// a slow client only ever gets the latest version, everything it missed is folded into one delta
+			if (!snapshot || snapshot->Seq <= *lastSeq) {
+				if (now - *lastWrite > std::chrono::seconds(3)) {
+					sink.write(": ping\n\n", 8);
+					*lastWrite = now;
+				}
+				return true;
+			}
+
+			std::string frame = "id: " + std::to_string(snapshot->Seq) + "\n";
+			if (binary) {
+				// Variant holds its lock while building, so get the binary body first
+				auto bin = snapshot->Variant("bin", SerializeActorsBinary);
+				auto body = snapshot->Variant("bin.base64", [&](const Snapshot &) {
+					return websocket::Base64Encode(*bin);
+				});
+				frame += "event: snapshot\ndata: " + *body + "\n\n";
+			} else if (!snapshot->Valid) {
+				frame += "event: error\ndata: " + snapshot->Body + "\n\n";
+			} else if (filter->IsFiltered()) {
+				thread_local std::vector<const ActorState *> selected;
+				filter->Select(*snapshot, selected);
+
+				thread_local std::string body;
+				body.clear();
+				GeoJsonWriter(body).FeatureCollection(*snapshot, selected);
+
+				// nothing changed in the view
+				auto hash = Fnv1a64(body);
+				*lastSeq = snapshot->Seq;
+				if (hash == *lastHash) {
+					if (now - *lastWrite > std::chrono::seconds(3)) {
+						sink.write(": ping\n\n", 8);
+						*lastWrite = now;
+					}
+					return true;
+				}
+				*lastHash = hash;
+
+				frame += "event: snapshot\ndata: " + body + "\n\n";
+			} else if (fullOnly || *lastSeq == 0) {
+				frame += "event: snapshot\ndata: " + snapshot->Body + "\n\n";
+			} else {
+				frame += "event: delta\ndata: " + *DeltaBody(snapshot, *lastSeq) + "\n\n";
+			}
+
+			sink.write(frame.data(), frame.size());
+			*lastSeq = snapshot->Seq;
+			*lastWrite = now;
+			return true;
+		}, [] {
+			--activeStreams;
+		});
+	});
+
+	if (config.IdleSampleMs > 0) {
+		scheduler = std::make_unique<ActorScheduler>(std::chrono::milliseconds(config.IdleSampleMs));
+	}
+	snapshots.Start(SampleActors, SerializeActors, config.SnapshotInterval, config.DeltaHistory);
+
+	trails = std::make_unique<TrailStore>(config.HistoryStatic);
+	trails->Follow(snapshots);
+
+	rollups = std::make_unique<RollupStore>(config.HistoryStatic);
+	rollups->Follow(snapshots);
+
+	if (config.SnapshotLogMB > 0) {
+		auto logDir = config.SnapshotLogDir.empty() ? (dllDir / "snapshot_log").string() : config.SnapshotLogDir;
+		if (!snapshotLog.Start(snapshots, logDir, (uint64_t)config.SnapshotLogMB << 20)) {
+			OutputDebugStringA("Unable to create the snapshot log directory.");
+		}
+	}
+
+	if (config.WebSocketPort > 0 && !sockets.Listen(config.IP, config.WebSocketPort, config.MaxStreams, ServeActorSocket)) {
+		OutputDebugStringA("Unable to listen on the WebSocket port.");
+	}
+
 	return true;
 }
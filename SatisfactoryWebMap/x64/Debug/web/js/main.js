@@ -54,6 +54,13 @@ window.onload = function () {
 
     var centerToPlayer = true;
     var playerLocation = null;
+
+    // below this zoom the Clusters overlay shows /api/clusters instead of every marker
+    const ClusterZoom = -7;
+
+    // what the markers were last asked for: clusters or not, zoom, world box or null for the whole map
+    var shown = { clustered: false, zoom: 0, box: null };
+    var openStream = null;
     const TypeName = [
         "Default", "Beacon", "Crate", "Hub",
         "Ping", "Player", "Radar Tower", "Resource",
@@ -67,7 +74,27 @@ window.onload = function () {
             [375e3, 425301.832031],
         ];
 
-        L.imageOverlay('/img/map.png', bounds).addTo(map);
+        // tiles once the server has cut the pyramid, the whole image until then or when cutting failed
+        fetch('/tiles/base/info.json')
+            .then(function (res) { return res.json(); })
+            .then(function (info) {
+                if (info.status !== 'ok') {
+                    throw new Error('base map tiles failed: ' + info.msg);
+                }
+                if (!info.ready) {
+                    throw new Error('base map tiles not ready');
+                }
+                L.tileLayer('/tiles/base/{z}/{x}/{y}.png', {
+                    minZoom: map.getMinZoom(),
+                    maxZoom: map.getMaxZoom(),
+                    minNativeZoom: info.min_zoom,
+                    maxNativeZoom: info.max_zoom,
+                    bounds: bounds,
+                }).addTo(map);
+            })
+            .catch(function () {
+                L.imageOverlay('/img/map.png', bounds).addTo(map);
+            });
         map.fitBounds(bounds);
         L.control.mousePosition().addTo(map);
         L.control.measure({
@@ -94,8 +121,70 @@ window.onload = function () {
         // var subgroup1 = L.featureGroup.subGroup(clusterGroup);
         // var realtime1 = createRealtimeLayer('/api/actors', subgroup1).addTo(map);
         var realtime1 = createRealtimeLayer('/api/actors').addTo(map);
+        if (window.EventSource) {
+            openStream = connectStream(realtime1);
+            openStream('/api/actors/stream');
+        }
+
+        var clusters = createClusterLayer();
+        var clusterMode = L.layerGroup();
+
+        // zoomed in, only ask for what is around the view. zoomed out with Clusters on,
+        // the markers stop and the server sends tens of clusters instead
+        function refresh() {
+            const zoom = Math.floor(map.getZoom());
+            const clustered = map.hasLayer(clusterMode) && zoom < ClusterZoom;
+
+            if (shown.clustered == clustered && (!clustered || shown.zoom == zoom)
+                && (shown.box ? boxContains(shown.box, viewBox(0)) : !viewBox(0.5))) {
+                return;
+            }
+
+            const box = viewBox(0.5);
+            const query = box ? 'bbox=' + box.map(Math.round).join(',') : '';
+
+            if (clustered) {
+                if (!shown.clustered) {
+                    if (openStream) {
+                        openStream(null);
+                    } else {
+                        realtime1.stop();
+                    }
+                    map.removeLayer(realtime1);
+                    clusters.addTo(map);
+                    clusters.start();
+                }
+                clusters.setUrl('/api/clusters?z=' + zoom + (query ? '&' + query : ''));
+            } else {
+                if (shown.clustered) {
+                    clusters.stop();
+                    map.removeLayer(clusters);
+                    realtime1.addTo(map);
+                }
+                if (openStream) {
+                    openStream('/api/actors/stream' + (query ? '?' + query : ''));
+                } else {
+                    realtime1.setUrl('/api/actors' + (query ? '?' + query : ''));
+                    if (shown.clustered) {
+                        realtime1.start();
+                    }
+                }
+            }
+
+            shown = { clustered: clustered, zoom: zoom, box: box };
+        }
+
+        map.on('moveend', refresh);
+        map.on('overlayadd overlayremove', function (e) {
+            if (e.layer === clusterMode) {
+                refresh();
+            }
+        });
+
         L.control.layers(null, {
             'Markers': realtime1,
+            'Clusters': clusterMode,
+            'Actor tiles': createTileLayer(),
         }).addTo(map);
 
         realtime1.once('update', function () {
@@ -112,12 +201,105 @@ window.onload = function () {
         return L.latLng(-y, x);
     }
 
+    // [minX, minY, maxX, maxY] in world units of the view grown by pad on every side,
+    // null when that covers the whole map
+    function viewBox(pad) {
+        const view = map.getBounds().pad(pad);
+        const box = [view.getWest(), -view.getNorth(), view.getEast(), -view.getSouth()];
+        if (box[0] <= -324698.832031 && box[1] <= -375e3 && box[2] >= 425301.832031 && box[3] >= 375e3) {
+            return null;
+        }
+        return box;
+    }
+
+    function boxContains(outer, inner) {
+        return inner != null && inner[0] >= outer[0] && inner[1] >= outer[1] && inner[2] <= outer[2] && inner[3] <= outer[3];
+    }
+
     function addMaker(pos) {
         return L.marker(worldToMap(pos));
     }
 
+    // push updates from /api/actors/stream instead of polling, one connection per page.
+    // Returns a function that (re)opens the stream on a url, the markers are kept between them.
+    function connectStream(layer) {
+        const known = {};
+
+        function apply(features) {
+            features.forEach(function (f) {
+                known[f.properties.index] = true;
+            });
+            if (features.length) {
+                layer.update({ type: 'FeatureCollection', features: features });
+            }
+        }
+
+        function remove(indices) {
+            const gone = indices.filter(function (i) { return known[i]; });
+            gone.forEach(function (i) {
+                delete known[i];
+            });
+            if (gone.length) {
+                layer.remove(gone.map(function (i) { return { properties: { index: i } }; }));
+            }
+        }
+
+        function replace(features) {
+            const keep = {};
+            features.forEach(function (f) {
+                keep[f.properties.index] = true;
+            });
+            remove(Object.keys(known).map(Number).filter(function (i) { return !keep[i]; }));
+            apply(features);
+        }
+
+        var source = null;
+        return function (url) {
+            if (source) {
+                source.close();
+                source = null;
+            }
+            if (!url) {
+                return;
+            }
+            source = new EventSource(url);
+            listen(source, url.replace('/api/actors/stream', '/api/actors'));
+        };
+
+        function listen(source, pollUrl) {
+            source.addEventListener('snapshot', function (e) {
+                const data = JSON.parse(e.data);
+                if (data.status == 'ok') {
+                    replace(data.features);
+                }
+            });
+            source.addEventListener('delta', function (e) {
+                const data = JSON.parse(e.data);
+                if (data.status != 'ok') {
+                    return;
+                }
+
+                if (data.full) {
+                    replace(data.added);
+                } else {
+                    remove(data.removed);
+                    apply(data.added.concat(data.changed));
+                }
+            });
+            source.onerror = function () {
+                // refused (too many streams), fall back to polling
+                if (source.readyState == EventSource.CLOSED) {
+                    openStream = null;
+                    layer.setUrl(pollUrl);
+                    layer.start();
+                }
+            };
+        }
+    }
+
     function createRealtimeLayer(url, container = null) {
         return L.realtime(url, {
+            start: !window.EventSource,
             interval: 1 * 1000, // 1 sec
             getFeatureId: function (f) {
                 return f.properties.index;
@@ -204,22 +386,100 @@ window.onload = function () {
                 marker.lastpos = feature.geometry.coordinates;
                 marker.lastupdate = performance.now();
 
-                const type = feature.properties.type;
-                if (type == 5) {
-                    marker.setIcon(greenIcon);
-                } else if (type == 1) {
-                    marker.setIcon(yellowIcon);
-                } else if (type == 3) {
-                    marker.setIcon(greyIcon);
-                } else if (type == 8) {
-                    marker.setIcon(blackIcon);
-                } else if (type == 12) {
-                    marker.setIcon(violetIcon);
+                const icon = typeIcon(feature.properties.type);
+                if (icon) {
+                    marker.setIcon(icon);
                 }
             }
         });
     }
 
+    function typeIcon(type) {
+        if (type == 5) {
+            return greenIcon;
+        } else if (type == 1) {
+            return yellowIcon;
+        } else if (type == 3) {
+            return greyIcon;
+        } else if (type == 8) {
+            return blackIcon;
+        } else if (type == 12) {
+            return violetIcon;
+        }
+        return null;
+    }
+
+    // /api/clusters, a circle with the count per cluster, single actors as plain markers
+    function clusterIcon(feature) {
+        if (!feature.properties.cluster) {
+            return typeIcon(feature.properties.type) || new L.Icon.Default();
+        }
+
+        const count = feature.properties.count;
+        const size = count < 100 ? 30 : count < 1000 ? 40 : 50;
+        return L.divIcon({
+            html: `<div><span>${count}</span></div>`,
+            className: 'actor-cluster',
+            iconSize: L.point(size, size),
+        });
+    }
+
+    // /tiles/actors as vector tiles, revalidated every few seconds: unchanged tiles are 304s
+    function createTileLayer() {
+        if (!L.vectorGrid) {
+            return L.layerGroup();
+        }
+
+        const tiles = L.vectorGrid.protobuf('/tiles/actors/{z}/{x}/{y}.mvt', {
+            minNativeZoom: -12,
+            maxNativeZoom: -2,
+            getFeatureId: function (f) {
+                return f.properties.index;
+            },
+            vectorTileLayerStyles: {
+                actors: function (properties) {
+                    return {
+                        radius: properties.type == 5 ? 6 : 4,
+                        fill: true,
+                        fillOpacity: 0.8,
+                        fillColor: properties.type == 5 ? '#2aad27' : '#2a81cb',
+                        color: '#fff',
+                        weight: 1,
+                    };
+                },
+            },
+        });
+
+        setInterval(function () {
+            if (map.hasLayer(tiles)) {
+                tiles.redraw();
+            }
+        }, 5 * 1000);
+        return tiles;
+    }
+
+    function createClusterLayer() {
+        return L.realtime('/api/clusters?z=' + ClusterZoom, {
+            start: false,
+            interval: 1 * 1000, // 1 sec
+            getFeatureId: function (f) {
+                return f.properties.cluster ? 'c' + f.properties.cluster_id : f.properties.index;
+            },
+            pointToLayer: function (feature) {
+                return L.marker(worldToMap(feature.geometry.coordinates), { icon: clusterIcon(feature) });
+            },
+            updateFeature: function (feature, marker) {
+                if (!marker) { return; }
+
+                marker.setLatLng(worldToMap(feature.geometry.coordinates));
+                if (feature.properties.cluster) {
+                    marker.setIcon(clusterIcon(feature));
+                }
+                return marker;
+            },
+        });
+    }
+
     function main() {
         setupMousePos();
         setupMap();